@@ -25,16 +25,63 @@
  */
 #include <json-schema.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
 #include <fstream>
+#include <future>
 #include <iostream>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+ #include <windows.h>
+#else
+ #include <dirent.h>
+ #include <fcntl.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ #include <unistd.h>
+#endif
 
 using nlohmann::json;
 using nlohmann::json_uri;
+using nlohmann::json_schema_draft4::compiled_schema;
 using nlohmann::json_schema_draft4::json_validator;
 
+class error_printer : public nlohmann::json_schema_draft4::basic_error_handler
+{
+	void error(const std::string &path, const json &instance, const std::string &message) override
+	{
+		basic_error_handler::error(path, instance, message);
+		std::cerr << "ERROR: At " << path << " - " << message << "\n";
+	}
+};
+
+class first_error : public nlohmann::json_schema_draft4::basic_error_handler
+{
+public:
+	std::string message;
+
+	void error(const std::string &path, const json &instance, const std::string &message) override
+	{
+		if (!*this)
+			this->message = "At " + path + " - " + message;
+		basic_error_handler::error(path, instance, message);
+	}
+};
+
 static void usage(const char *name)
 {
-	std::cerr << "Usage: " << name << " <schema> < <document>\n";
+	std::cerr << "Usage: " << name << " [--ndjson] [--threads <n>] <schema> < <document>\n"
+	          << "       " << name << " [--threads <n>] <schema> <document|directory>...\n"
+	          << "  --ndjson       each line of the input is a document, a result is printed per line\n"
+	          << "  --threads <n>  number of threads parsing and validating, default: one per core\n"
+	          << "Documents given as files are validated in parallel, directories are searched\n"
+	          << "recursively for *.json-files.\n";
 	exit(EXIT_FAILURE);
 }
 
@@ -58,14 +105,334 @@ static void loader(const json_uri &uri, json &schema)
 	}
 }
 
+// Validates newline-delimited JSON documents read from input.
+//
+// Lines are read into a bounded window, the worker-threads parse and
+// validate them in any order while the results are printed in the order of
+// the lines as soon as the oldest line is done.
+class ndjson_pipeline
+{
+	struct line {
+		std::size_t number;
+		std::string text;
+		bool done = false;
+		first_error result;
+	};
+
+	const compiled_schema &schema_;
+	const unsigned threads_;
+	const std::size_t capacity_;
+
+	std::mutex mutex_;
+	std::condition_variable work_, done_, space_;
+	std::deque<line> window_; // references to lines stay valid while they are in the window
+	std::size_t next_ = 0;    // index in the window of the next line to be validated
+	bool eof_ = false;
+
+	void read(std::istream &input)
+	{
+		std::size_t number = 0;
+		std::string text;
+
+		while (std::getline(input, text)) {
+			number++;
+			if (text.find_first_not_of(" \t\r") == std::string::npos)
+				continue;
+
+			std::unique_lock<std::mutex> lock(mutex_);
+			space_.wait(lock, [this] { return window_.size() < capacity_; });
+
+			window_.emplace_back();
+			window_.back().number = number;
+			window_.back().text.swap(text);
+			work_.notify_one();
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		eof_ = true;
+		work_.notify_all();
+		done_.notify_all();
+	}
+
+	void validate()
+	{
+		for (;;) {
+			line *l;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				work_.wait(lock, [this] { return next_ < window_.size() || eof_; });
+				if (next_ == window_.size())
+					return;
+				l = &window_[next_++];
+			}
+
+			try {
+				schema_.validate(json::parse(l->text), l->result);
+			} catch (std::exception &e) {
+				l->result.error("#", json(), e.what());
+			}
+
+			std::lock_guard<std::mutex> lock(mutex_);
+			l->done = true;
+			done_.notify_all();
+		}
+	}
+
+public:
+	ndjson_pipeline(const compiled_schema &schema, unsigned threads)
+	    : schema_(schema), threads_(threads), capacity_(64 * threads)
+	{
+	}
+
+	// returns the number of invalid lines
+	std::size_t run(std::istream &input, std::ostream &output)
+	{
+		std::thread reader(&ndjson_pipeline::read, this, std::ref(input));
+
+		std::vector<std::thread> workers;
+		for (unsigned i = 0; i < threads_; i++)
+			workers.emplace_back(&ndjson_pipeline::validate, this);
+
+		std::size_t invalid = 0;
+		std::unique_lock<std::mutex> lock(mutex_);
+		for (;;) {
+			done_.wait(lock, [this] { return (!window_.empty() && window_.front().done) || (eof_ && window_.empty()); });
+			if (window_.empty())
+				break;
+
+			line &l = window_.front();
+			if (l.result) {
+				invalid++;
+				output << l.number << ": invalid - " << l.result.message << "\n";
+			} else
+				output << l.number << ": valid\n";
+
+			window_.pop_front();
+			next_--;
+			space_.notify_one();
+		}
+		lock.unlock();
+
+		reader.join();
+		for (auto &worker : workers)
+			worker.join();
+
+		return invalid;
+	}
+};
+
+// The content of a file, memory-mapped where this is available.
+class mapped_file
+{
+	const char *data_ = nullptr;
+	std::size_t size_ = 0;
+#ifdef _WIN32
+	std::string content_;
+#endif
+
+public:
+	explicit mapped_file(const std::string &path)
+	{
+#ifdef _WIN32
+		std::ifstream f(path, std::ios::binary);
+		if (!f.good())
+			throw std::runtime_error("could not open " + path + " for reading");
+
+		content_.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+		data_ = content_.data();
+		size_ = content_.size();
+#else
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			throw std::runtime_error("could not open " + path + " for reading");
+
+		struct stat st;
+		if (fstat(fd, &st) != 0) {
+			close(fd);
+			throw std::runtime_error("could not stat " + path);
+		}
+
+		if (st.st_size > 0) { // empty files cannot be mapped
+			void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data != MAP_FAILED) {
+				data_ = static_cast<const char *>(data);
+				size_ = st.st_size;
+			}
+		}
+		close(fd);
+
+		if (data_ == nullptr && st.st_size > 0)
+			throw std::runtime_error("could not map " + path);
+#endif
+	}
+
+	~mapped_file()
+	{
+#ifndef _WIN32
+		if (data_)
+			munmap(const_cast<char *>(data_), size_);
+#endif
+	}
+
+	mapped_file(const mapped_file &) = delete;
+	mapped_file &operator=(const mapped_file &) = delete;
+
+	const char *begin() const { return data_; }
+	const char *end() const { return data_ + size_; }
+};
+
+static bool is_directory(const std::string &path)
+{
+#ifdef _WIN32
+	DWORD attributes = GetFileAttributesA(path.c_str());
+	return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+	struct stat st;
+	return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+#endif
+}
+
+// the names of the entries of a directory, without . and ..
+static std::vector<std::string> directory_entries(const std::string &path)
+{
+	std::vector<std::string> entries;
+
+#ifdef _WIN32
+	WIN32_FIND_DATAA entry;
+	HANDLE dir = FindFirstFileA((path + "\\*").c_str(), &entry);
+	if (dir == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("could not read directory " + path);
+
+	do
+		entries.push_back(entry.cFileName);
+	while (FindNextFileA(dir, &entry));
+	FindClose(dir);
+#else
+	DIR *dir = opendir(path.c_str());
+	if (dir == nullptr)
+		throw std::runtime_error("could not read directory " + path);
+
+	while (const struct dirent *entry = readdir(dir))
+		entries.push_back(entry->d_name);
+	closedir(dir);
+#endif
+
+	entries.erase(std::remove_if(entries.begin(), entries.end(),
+	                             [](const std::string &name) { return name == "." || name == ".."; }),
+	              entries.end());
+	std::sort(entries.begin(), entries.end());
+	return entries;
+}
+
+// files are taken as they are, directories are searched recursively for *.json-files
+static void collect_documents(const std::string &path, bool explicit_path, std::vector<std::string> &documents)
+{
+	if (is_directory(path)) {
+		for (const auto &entry : directory_entries(path))
+			collect_documents(path + "/" + entry, false, documents);
+	} else if (explicit_path || (path.size() > 5 && path.compare(path.size() - 5, 5, ".json") == 0))
+		documents.push_back(path);
+}
+
+// Validates files on a number of threads, each taking the next file when it
+// is done with the previous one. The results are printed in the order of the
+// files when all are done.
+static std::size_t validate_files(const compiled_schema &schema, const std::vector<std::string> &documents, unsigned threads)
+{
+	struct file_result {
+		first_error result;
+		double seconds;
+	};
+	std::vector<file_result> results(documents.size());
+	std::atomic<std::size_t> next(0);
+
+	auto work = [&]() {
+		for (std::size_t i; (i = next++) < documents.size();) {
+			const auto start = std::chrono::steady_clock::now();
+
+			try {
+				mapped_file file(documents[i]);
+				schema.validate(json::parse(file.begin(), file.end()), results[i].result);
+			} catch (std::exception &e) {
+				results[i].result.error("#", json(), e.what());
+			}
+
+			results[i].seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+	};
+
+	const auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> workers;
+	for (unsigned i = 1; i < threads; i++)
+		workers.emplace_back(work);
+	work();
+	for (auto &worker : workers)
+		worker.join();
+
+	const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::size_t invalid = 0;
+	double total = 0;
+	for (std::size_t i = 0; i < documents.size(); i++) {
+		const auto &r = results[i];
+
+		std::cout << documents[i] << ": ";
+		if (r.result) {
+			invalid++;
+			std::cout << "invalid - " << r.result.message;
+		} else
+			std::cout << "valid";
+		std::cout << " (" << r.seconds * 1000 << " ms)\n";
+
+		total += r.seconds;
+	}
+
+	std::cerr << documents.size() << " documents, " << invalid << " invalid - "
+	          << elapsed << " s elapsed on " << threads << " threads, "
+	          << total << " s validating all documents, "
+	          << (elapsed > 0 ? documents.size() / elapsed : 0) << " documents/s\n";
+
+	return invalid;
+}
+
 int main(int argc, char *argv[])
 {
-	if (argc != 2)
+	const char *schema_file = nullptr;
+	std::vector<std::string> documents;
+	bool ndjson = false;
+	unsigned threads = 0;
+
+	for (int i = 1; i < argc; i++) {
+		const std::string arg = argv[i];
+
+		if (arg == "--ndjson")
+			ndjson = true;
+		else if (arg == "--threads" && i + 1 < argc)
+			threads = std::strtoul(argv[++i], nullptr, 10);
+		else if (arg[0] == '-')
+			usage(argv[0]);
+		else if (schema_file == nullptr)
+			schema_file = argv[i];
+		else {
+			try {
+				collect_documents(arg, true, documents);
+			} catch (std::exception &e) {
+				std::cerr << e.what() << "\n";
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	if (schema_file == nullptr || (ndjson && !documents.empty()))
 		usage(argv[0]);
 
-	std::fstream f(argv[1]);
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+
+	std::fstream f(schema_file);
 	if (!f.good()) {
-		std::cerr << "could not open " << argv[1] << " for reading\n";
+		std::cerr << "could not open " << schema_file << " for reading\n";
 		usage(argv[0]);
 	}
 
@@ -79,26 +446,62 @@ int main(int argc, char *argv[])
 	}
 
 	// 2) create the validator and
-	json_validator validator(loader, [](const std::string &, const std::string &) {});
+	json_validator validator(loader, nlohmann::json_schema_draft4::default_format_registry());
+
+	// referenced schemas are read in parallel
+	validator.set_async_loader([](const json_uri &uri) {
+		return std::async(std::launch::async, [uri]() {
+			json schema;
+			loader(uri, schema);
+			return schema;
+		});
+	});
 
 	try {
 		// insert this schema as the root to the validator
 		// this resolves remote-schemas, sub-schemas and references via the given loader-function
-		validator.set_root_schema(schema);
+		validator.set_root_schema(std::move(schema));
 	} catch (std::exception &e) {
 		std::cerr << "setting root schema failed\n";
 		std::cerr << e.what() << "\n";
 	}
 
-	// 3) do the actual validation of the document
-	json document;
+	// 3) do the actual validation of the document(s)
+	if (!documents.empty()) {
+		if (validate_files(*validator.compiled(), documents, threads) > 0) {
+			std::cerr << "schema validation failed\n";
+			return EXIT_FAILURE;
+		}
+
+		std::cerr << "all documents are valid\n";
+		return EXIT_SUCCESS;
+	}
+
+	if (ndjson) {
+		ndjson_pipeline pipeline(*validator.compiled(), threads);
+
+		if (pipeline.run(std::cin, std::cout) > 0) {
+			std::cerr << "schema validation failed\n";
+			return EXIT_FAILURE;
+		}
+
+		std::cerr << "all documents are valid\n";
+		return EXIT_SUCCESS;
+	}
+
+	// a single document is validated while it is read, it is not kept in memory
+	error_printer err;
 
 	try {
-		std::cin >> document;
-		validator.validate(document);
+		validator.validate_stream(std::cin, err);
 	} catch (std::exception &e) {
 		std::cerr << "schema validation failed\n";
-		std::cerr << e.what() << " at offset: " << std::cin.tellg() << "\n";
+		std::cerr << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	if (err) {
+		std::cerr << "schema validation failed\n";
 		return EXIT_FAILURE;
 	}
 
@@ -0,0 +1,240 @@
+/*
+ * Modern C++ JSON schema validator
+ *
+ * Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+ *
+ * Copyright (c) 2016 Patrick Boettcher <patrick.boettcher@posteo.de>.
+ *
+ * Permission is hereby  granted, free of charge, to any  person obtaining a
+ * copy of this software and associated  documentation files (the "Software"),
+ * to deal in the Software  without restriction, including without  limitation
+ * the rights to  use, copy,  modify, merge,  publish, distribute,  sublicense,
+ * and/or  sell copies  of  the Software,  and  to  permit persons  to  whom
+ * the Software  is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS
+ * OR IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN
+ * NO EVENT  SHALL THE AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY
+ * CLAIM,  DAMAGES OR  OTHER LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT
+ * OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR
+ * THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <json-schema.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+using nlohmann::json;
+using nlohmann::json_schema_draft4::basic_error_handler;
+using nlohmann::json_schema_draft4::batch_result;
+
+namespace
+{
+
+// records the first error of a document in its batch-result
+class result_error_handler : public basic_error_handler
+{
+	batch_result &result_;
+
+public:
+	result_error_handler(batch_result &result)
+	    : result_(result) {}
+
+	void error(const std::string &path, const json &instance, const std::string &message) override
+	{
+		if (result_.valid) {
+			result_.valid = false;
+			result_.error = "At " + path + " - " + message;
+		}
+		basic_error_handler::error(path, instance, message);
+	}
+};
+
+unsigned worker_count(unsigned threads)
+{
+	if (threads == 0)
+		threads = std::thread::hardware_concurrency();
+
+	return std::max(threads, 1u);
+}
+
+// Runs work(worker-index) on n workers, the calling thread being the first one.
+//
+// The first exception thrown by a worker makes failed() return true, so
+// that the others can stop, and is rethrown once all of them are done.
+class worker_group
+{
+	std::mutex mutex_;
+	std::exception_ptr exception_;
+	std::atomic<bool> failed_;
+
+public:
+	worker_group()
+	    : failed_(false) {}
+
+	bool failed() const { return failed_; }
+
+	template <class Work>
+	void run(unsigned n, Work work)
+	{
+		auto guarded = [this, &work](unsigned worker) {
+			try {
+				work(worker);
+			} catch (...) {
+				std::lock_guard<std::mutex> lock(mutex_);
+				if (!exception_)
+					exception_ = std::current_exception();
+				failed_ = true;
+			}
+		};
+
+		std::vector<std::thread> threads;
+		for (unsigned i = 1; i < n; i++) {
+			try {
+				threads.emplace_back(guarded, i);
+			} catch (const std::system_error &) {
+				break; // the running workers will take over the work of the missing ones
+			}
+		}
+
+		guarded(0);
+
+		for (auto &t : threads)
+			t.join();
+
+		if (exception_)
+			std::rethrow_exception(exception_);
+	}
+};
+
+// document-indices owned by one worker: the owner takes them one by one from
+// the front, other workers which ran out of work steal the back half
+struct work_range {
+	std::mutex mutex;
+	std::size_t begin = 0;
+	std::size_t end = 0;
+
+	bool take(std::size_t &index)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (begin == end)
+			return false;
+		index = begin++;
+		return true;
+	}
+
+	bool steal_from(work_range &victim)
+	{
+		std::size_t b, e;
+		{
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			std::size_t half = (victim.end - victim.begin + 1) / 2;
+			if (half == 0)
+				return false;
+			e = victim.end;
+			b = victim.end -= half;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		begin = b;
+		end = e;
+		return true;
+	}
+};
+
+} // anonymous namespace
+
+namespace nlohmann
+{
+namespace json_schema_draft4
+{
+
+std::vector<batch_result> compiled_schema::validate_batch(const std::vector<json> &instances, unsigned threads) const
+{
+	std::vector<batch_result> results(instances.size());
+
+	const unsigned n = std::min<std::size_t>(worker_count(threads), std::max<std::size_t>(instances.size(), 1));
+
+	// distribute the documents evenly to start with
+	std::vector<work_range> ranges(n);
+	for (unsigned i = 0; i < n; i++) {
+		ranges[i].begin = instances.size() * i / n;
+		ranges[i].end = instances.size() * (i + 1) / n;
+	}
+
+	worker_group group;
+	group.run(n, [&](unsigned worker) {
+		auto &own = ranges[worker];
+
+		while (!group.failed()) {
+			std::size_t index;
+
+			if (own.take(index)) {
+				result_error_handler e(results[index]);
+				validate(instances[index], e);
+				continue;
+			}
+
+			// out of work - steal from the others, done when there is nothing left
+			bool stolen = false;
+			for (unsigned i = 1; i < n && !stolen; i++)
+				stolen = own.steal_from(ranges[(worker + i) % n]);
+
+			if (!stolen)
+				break;
+		}
+	});
+
+	return results;
+}
+
+std::vector<batch_result> compiled_schema::validate_batch(const std::function<bool(json &)> &source, unsigned threads) const
+{
+	const unsigned n = worker_count(threads);
+
+	std::mutex source_mutex;
+	bool exhausted = false;
+	std::size_t count = 0;
+
+	// results of each worker together with the index of their document
+	std::vector<std::vector<std::pair<std::size_t, batch_result>>> worker_results(n);
+
+	worker_group group;
+	group.run(n, [&](unsigned worker) {
+		json instance;
+
+		while (!group.failed()) {
+			std::size_t index;
+			{
+				std::lock_guard<std::mutex> lock(source_mutex);
+				if (exhausted || !source(instance)) {
+					exhausted = true;
+					break;
+				}
+				index = count++;
+			}
+
+			worker_results[worker].emplace_back(index, batch_result());
+			result_error_handler e(worker_results[worker].back().second);
+			validate(instance, e);
+		}
+	});
+
+	std::vector<batch_result> results(count);
+	for (auto &r : worker_results)
+		for (auto &result : r)
+			results[result.first] = std::move(result.second);
+
+	return results;
+}
+
+} // namespace json_schema_draft4
+} // namespace nlohmann
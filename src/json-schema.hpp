@@ -40,6 +40,8 @@
 
 #include <nlohmann/json.hpp>
 
+#include <future>
+
 // make yourself a home - welcome to nlohmann's namespace
 namespace nlohmann
 {
@@ -167,34 +169,266 @@ namespace json_schema_draft4
 
 extern json draft4_schema_builtin;
 
+// checks the string-formats defined by draft 4: date-time, email, hostname,
+// ipv4, ipv6 and uri - can be given as format-checker to json_validator,
+// throws std::invalid_argument for invalid values, other formats are accepted
+JSON_SCHEMA_VALIDATOR_API void default_string_format_check(const std::string &format, const std::string &value);
+
+// checks a value of one string-format, throws an exception (usually
+// std::invalid_argument) with a message if the value does not comply
+typedef std::function<void(const std::string &value)> format_checker;
+
+// Format-checkers by format-name.
+//
+// The checker of each format-keyword is looked up once, when the schema is
+// compiled, a schema using a format which is not registered is rejected.
+class JSON_SCHEMA_VALIDATOR_API format_registry
+{
+	std::map<std::string, format_checker> checkers_;
+
+public:
+	void add(const std::string &format, format_checker checker) { checkers_[format] = std::move(checker); }
+
+	const format_checker *find(const std::string &format) const
+	{
+		auto checker = checkers_.find(format);
+		return checker == checkers_.end() ? nullptr : &checker->second;
+	}
+
+	bool empty() const { return checkers_.empty(); }
+};
+
+// the formats of default_string_format_check(), each with its own checker
+JSON_SCHEMA_VALIDATOR_API format_registry default_format_registry();
+
+// compiled representation of a (sub-)schema, see json-validator.cpp
+class schema;
+
+// position inside the validated instance, see json-validator.cpp
+class instance_path;
+
+// interface for reporting validation errors without exceptions
+//
+// error() is called for each error found in the instance, path is the JSON
+// pointer (RFC 6901, URI-fragment form, e.g. "#/items/0") of the
+// instance-element in question. The default implementation only remembers
+// that an error happened, which can be queried with the bool-operator.
+class JSON_SCHEMA_VALIDATOR_API basic_error_handler
+{
+	bool error_ = false;
+
+public:
+	virtual ~basic_error_handler() {}
+
+	virtual void error(const std::string & /*path*/, const json & /*instance*/, const std::string & /*message*/)
+	{
+		error_ = true;
+	}
+
+	void reset() { error_ = false; }
+	operator bool() const { return error_; }
+};
+
+// outcome of validating one document of a batch
+struct JSON_SCHEMA_VALIDATOR_API batch_result {
+	bool valid = true;
+	std::string error; // the first error found: "At <JSON pointer> - <message>"
+};
+
+class json_validator;
+class sax_validator;
+
+// A compiled root-schema together with all the schemas it references.
+//
+// It is created by json_validator::set_root_schema() and is immutable
+// afterwards: validate() is const and can be called concurrently from any
+// number of threads without locking, provided the format-checker can be as
+// well. It can be shared and outlive the validator which created it.
+class JSON_SCHEMA_VALIDATOR_API compiled_schema
+{
+	friend class json_validator;
+	friend class sax_validator;
+
+	std::vector<std::shared_ptr<const json>> schema_store_;
+	format_registry formats_;
+	std::function<void(const std::string &, const std::string &)> format_check_ = nullptr; // for formats not registered
+
+	// the locations (URLs or URNs) of all schemas, interned
+	std::map<std::string, std::size_t> locations_;
+
+	// schemas which can be referred to by an id, and targets of $refs once
+	// they have been looked up - by location-index and JSON-pointer
+	std::map<std::pair<std::size_t, std::string>, const json *> schema_refs_;
+
+	const json *registered(const std::string &location, const std::string &pointer) const;
+	void register_schema(const std::string &location, const std::string &pointer, const json *schema);
+
+	// the (sub-)schema referred to by uri, found by its JSON-pointer if
+	// needed, nullptr if there is none
+	const json *find_schema(const json_uri &uri);
+
+	// the absolute URI of each $ref by the schema containing it - the
+	// inserted schemas themselves are not modified
+	std::map<const json *, std::string> absolute_refs_;
+
+	// all compiled (sub-)schemas indexed by the schema-object they were created from
+	std::map<const json *, std::shared_ptr<schema>> compiled_;
+	const schema *root_ = nullptr;
+
+	const schema *compile(const json &schema);
+
+	// links each $ref directly to the end of its chain of $refs
+	void link_refs();
+
+	// the schema a $ref is linked to, or the schema itself
+	const schema *resolve_refs(const schema &schema) const;
+
+	// indexes the branches of anyOf and oneOf of all compiled schemas
+	void index_branches();
+
+	void validate(const json &instance, const schema &schema_, const instance_path &path, basic_error_handler &e) const;
+	void validate_array(const json &instance, const schema &schema, const instance_path &path, basic_error_handler &e) const;
+	void validate_object(const json &instance, const schema &schema, const instance_path &path, basic_error_handler &e) const;
+	void validate_string(const json &instance, const schema &schema, const instance_path &path, basic_error_handler &e) const;
+
+public:
+	// validate a json-document based on the root-schema
+	// throws std::invalid_argument for the first error found
+	void validate(const json &instance) const;
+
+	// validate a json-document based on the root-schema
+	// all errors are reported to the error-handler, none is thrown
+	void validate(const json &instance, basic_error_handler &e) const;
+
+	// validate many json-documents in parallel, threads == 0 uses one thread per core
+	//
+	// the documents are distributed over the worker-threads which steal
+	// work from each other when they run out of it. The results are in
+	// the order of the documents.
+	std::vector<batch_result> validate_batch(const std::vector<json> &instances, unsigned threads = 0) const;
+
+	// same, but documents are pulled from source until it returns false
+	std::vector<batch_result> validate_batch(const std::function<bool(json &)> &source, unsigned threads = 0) const;
+
+	// validate a json-document while parsing it from a stream, see sax_validator
+	// throws std::invalid_argument if the document cannot be parsed
+	void validate_stream(std::istream &stream, basic_error_handler &e) const;
+};
+
+// Validates a json-document while it is parsed, without building it in memory.
+//
+// It is the SAX-handler to be given to json::sax_parse(). The compiled schema
+// is evaluated on the parser-events as they arrive and only the state of the
+// currently open objects and arrays is held - except for values a keyword
+// needs as a whole (enum and uniqueItems of objects and arrays) which are
+// collected while they are parsed.
+//
+// Errors are reported to the error-handler as with validate(), for objects
+// and arrays which have not been collected the instance passed to it is empty.
+class JSON_SCHEMA_VALIDATOR_API sax_validator
+{
+	struct impl;
+	std::unique_ptr<impl> impl_;
+
+	bool value(json &&scalar);
+	bool start(json::value_t type);
+	bool end();
+	bool error(const std::string &message);
+
+public:
+	sax_validator(const compiled_schema &schema, basic_error_handler &e);
+	~sax_validator();
+
+	// SAX-interface
+	bool null() { return value(nullptr); }
+	bool boolean(bool val) { return value(val); }
+	bool number_integer(json::number_integer_t val) { return value(val); }
+	bool number_unsigned(json::number_unsigned_t val) { return value(val); }
+	bool number_float(json::number_float_t val, const json::string_t &) { return value(val); }
+	bool string(json::string_t &val) { return value(std::move(val)); }
+
+	template <class Binary>
+	bool binary(Binary &) { return error("binary values cannot be validated"); }
+
+	bool start_object(std::size_t) { return start(json::value_t::object); }
+	bool key(json::string_t &val);
+	bool end_object() { return end(); }
+
+	bool start_array(std::size_t) { return start(json::value_t::array); }
+	bool end_array() { return end(); }
+
+	template <class Exception>
+	bool parse_error(std::size_t, const std::string &, const Exception &ex) { return error(ex.what()); }
+
+	// the reason why parsing has been stopped, empty if it did not
+	const std::string &parse_error_message() const;
+};
+
+// Loads schemas, resolves their references and compiles them.
 class JSON_SCHEMA_VALIDATOR_API json_validator
 {
-	std::vector<std::shared_ptr<json>> schema_store_;
-	std::shared_ptr<json> root_schema_;
+	std::shared_ptr<const json> root_schema_;
 	std::function<void(const json_uri &, json &)> schema_loader_ = nullptr;
-	std::function<void(const std::string &, const std::string &)> format_check_ = nullptr;
 
-	std::map<json_uri, const json *> schema_refs_;
+	std::function<std::future<json>(const json_uri &)> async_loader_ = nullptr;
+	std::size_t max_pending_ = 8;
+
+	// documents fetched ahead by the async loader, waiting to be inserted
+	std::map<json_uri, std::shared_ptr<const json>> prefetched_;
 
-	void validate(const json &instance, const json &schema_, const std::string &name);
-	void validate_array(const json &instance, const json &schema_, const std::string &name);
-	void validate_object(const json &instance, const json &schema_, const std::string &name);
-    void validate_string(const json &instance, const json &schema, const std::string &name);
+	std::shared_ptr<compiled_schema> schema_;
 
-	void insert_schema(const json &input, const json_uri &id);
+	void insert_schema(std::shared_ptr<const json> schema, const json_uri &id);
+	std::shared_ptr<const json> load(const json_uri &url);
+	void prefetch(const json &schema, const json_uri &id);
 
 public:
 	json_validator(std::function<void(const json_uri &, json &)> loader = nullptr,
 	               std::function<void(const std::string &, const std::string &)> format = nullptr)
-	    : schema_loader_(loader), format_check_(format)
+	    : schema_loader_(loader), schema_(std::make_shared<compiled_schema>())
 	{
+		schema_->format_check_ = format;
+	}
+
+	// formats are checked by the checkers of the registry, the format-callback
+	// is used for those not found in it
+	json_validator(std::function<void(const json_uri &, json &)> loader,
+	               format_registry formats,
+	               std::function<void(const std::string &, const std::string &)> format = nullptr)
+	    : json_validator(loader, format)
+	{
+		schema_->formats_ = std::move(formats);
+	}
+
+	// Loads referenced schemas asynchronously instead of the loader given to
+	// the constructor: when a root-schema is set, all schemas it references
+	// are requested at once, as are those they reference as soon as they
+	// arrive - with at most max_pending requests outstanding.
+	void set_async_loader(std::function<std::future<json>(const json_uri &)> loader, std::size_t max_pending = 8)
+	{
+		async_loader_ = loader;
+		max_pending_ = max_pending ? max_pending : 1;
 	}
 
 	// insert and set a root-schema
+	// all keywords of the schema and its sub-schemas are compiled once here
+	//
+	// the validator keeps the schema: a copy of it, what is moved out of it or
+	// the shared document itself, which is never modified
 	void set_root_schema(const json &);
-
-	// validate a json-document based on the root-schema
-	void validate(const json &instance);
+	void set_root_schema(json &&);
+	void set_root_schema(std::shared_ptr<const json>);
+
+	// the compiled root-schema, to be shared for example between threads
+	std::shared_ptr<const compiled_schema> compiled() const { return schema_; }
+
+	// validate a json-document based on the root-schema, see compiled_schema
+	// safe to be called concurrently once the root-schema has been set
+	void validate(const json &instance) const;
+	void validate(const json &instance, basic_error_handler &e) const;
+	std::vector<batch_result> validate_batch(const std::vector<json> &instances, unsigned threads = 0) const;
+	std::vector<batch_result> validate_batch(const std::function<bool(json &)> &source, unsigned threads = 0) const;
+	void validate_stream(std::istream &stream, basic_error_handler &e) const;
 };
 
 } // json_schema_draft4
@@ -25,6 +25,7 @@
  */
 #include "json-schema.hpp"
 
+#include <cctype>
 #include <sstream>
 
 namespace nlohmann
@@ -129,8 +130,22 @@ std::ostream &operator<<(std::ostream &os, const json_uri &u)
 
 std::string json_uri::unescape(const std::string &src)
 {
-	std::string l = src;
-	std::size_t pos = src.size() - 1;
+	// %-sequences of the URI-fragment first, then ~-sequences of the JSON-pointer
+	std::string l;
+	for (std::size_t i = 0; i < src.size(); i++) {
+		if (src[i] == '%' && i + 2 < src.size() &&
+		    std::isxdigit(static_cast<unsigned char>(src[i + 1])) &&
+		    std::isxdigit(static_cast<unsigned char>(src[i + 2]))) {
+			l += static_cast<char>(std::stoi(src.substr(i + 1, 2), nullptr, 16));
+			i += 2;
+		} else
+			l += src[i];
+	}
+
+	if (l.empty())
+		return l;
+
+	std::size_t pos = l.size() - 1;
 
 	do {
 		pos = l.rfind('~', pos);
@@ -158,8 +173,6 @@ std::string json_uri::unescape(const std::string &src)
 		pos--;
 	} while (pos != std::string::npos);
 
-	// TODO - percent handling
-
 	return l;
 }
 
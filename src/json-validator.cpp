@@ -25,7 +25,13 @@
  */
 #include <json-schema.hpp>
 
+#include <cmath>
+#include <deque>
+#include <list>
 #include <set>
+#include <sstream>
+#include <tuple>
+#include <unordered_set>
 
 using nlohmann::json;
 using nlohmann::json_uri;
@@ -33,6 +39,9 @@ using nlohmann::json_uri;
 #ifdef JSON_SCHEMA_BOOST_REGEX
  #include <boost/regex.hpp>
  #define REGEX_NAMESPACE boost
+#elif defined(JSON_SCHEMA_LINEAR_REGEX)
+ #include "linear-regex.hpp"
+ #define REGEX_NAMESPACE nlohmann::json_schema_draft4::linear_regex
 #elif defined(JSON_SCHEMA_NO_REGEX)
  #define NO_STD_REGEX
 #else
@@ -40,28 +49,95 @@ using nlohmann::json_uri;
  #define REGEX_NAMESPACE std
 #endif
 
+// SSE2 is part of x86-64, AVX2 is selected at runtime where the compiler
+// allows to build code for it separately
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+ #include <emmintrin.h>
+ #define UTF8_SSE2
+ #if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  #include <immintrin.h>
+  #define UTF8_AVX2
+ #endif
+#endif
+
 namespace
 {
 
+// the location (URN or URL) of an uri and its JSON-pointer, which starts with a #
+void split_uri(const json_uri &uri, std::string &location, std::string &pointer)
+{
+	pointer = uri.pointer().to_string();
+	location = uri.to_string();
+	location.resize(location.size() - pointer.size());
+}
+
+// follows the rest of a JSON-pointer, starting at pos, from a (sub-)schema
+const json *follow_pointer(const json *schema, const std::string &pointer, std::size_t pos)
+{
+	while (schema && pos < pointer.size()) {
+		std::size_t next = pointer.find('/', pos + 1);
+		std::string token = json_uri::unescape(pointer.substr(pos + 1, next - pos - 1));
+		pos = next;
+
+		if (schema->type() == json::value_t::object) {
+			auto child = schema->find(token);
+			schema = child != schema->end() ? &child.value() : nullptr;
+		} else if (schema->type() == json::value_t::array &&
+		           !token.empty() && token.find_first_not_of("0123456789") == std::string::npos) {
+			std::size_t index = std::stoul(token);
+			schema = index < schema->size() ? &(*schema)[index] : nullptr;
+		} else
+			schema = nullptr;
+	}
+
+	return schema;
+}
+
+// finds the (sub-)schema an uri refers to: only some schemas are registered
+// by their location and pointer (see resolver), others are found from the
+// registered one with the longest pointer which is a prefix of the uri's
+template <class Registered>
+const json *lookup_schema(const json_uri &uri, const Registered &registered)
+{
+	std::string location, pointer;
+	split_uri(uri, location, pointer);
+
+	for (std::size_t end = pointer.size(); end != 0 && end != std::string::npos; end = pointer.rfind('/', end - 1)) {
+		const json *schema = registered(location, pointer.substr(0, end));
+		if (schema)
+			return follow_pointer(schema, pointer, end);
+	}
+
+	return nullptr;
+}
+
+// Registers the schemas of a document which can be referred to by an id: its
+// root and every schema with an id - keyed by location and pointer. Other
+// schemas are found by their JSON-pointer when they are referenced.
+//
+// The document is not modified, the absolute URIs of its $refs are collected.
 class resolver
 {
-	void resolve(json &schema, json_uri id)
+	// pointer is the path from base, the uri of the innermost schema with an id
+	void resolve(const json &schema, const json_uri &base, std::string &pointer)
 	{
 		// look for the id-field in this schema
 		auto fid = schema.find("id");
 
-		// found?
-		if (fid != schema.end() &&
-		    fid.value().type() == json::value_t::string)
-			id = id.derive(fid.value()); // resolve to a full id with URL + path based on the parent
+		// found? - resolve to a full id with URL + path based on the parent
+		if (fid != schema.end() && fid.value().type() == json::value_t::string) {
+			json_uri id = here(base, pointer).derive(fid.value());
+			add(id, schema);
 
-		// already existing - error
-		if (schema_refs.find(id) != schema_refs.end())
-			throw std::invalid_argument("schema " + id.to_string() + " already present in local resolver");
+			std::string inner;
+			resolve_children(schema, id, inner);
+		} else
+			resolve_children(schema, base, pointer);
+	}
 
-		// store a raw pointer to this (sub-)schema referenced by its absolute json_uri
-		// this (sub-)schema is part of a schema stored inside schema_store_ so we can use the a raw-pointer-ref
-		schema_refs[id] = &schema;
+	void resolve_children(const json &schema, const json_uri &base, std::string &pointer)
+	{
+		const std::size_t length = pointer.size();
 
 		for (auto i = schema.begin(), end = schema.end(); i != end; ++i) {
 			// FIXME: this inhibits the user adding properties with the key "default"
@@ -71,23 +147,31 @@ class resolver
 			switch (i.value().type()) {
 
 			case json::value_t::object: // child is object, it is a schema
-				resolve(i.value(), id.append(json_uri::escape(i.key())));
+				append(pointer, i.key());
+				resolve(i.value(), base, pointer);
+				pointer.resize(length);
 				break;
 
 			case json::value_t::array: {
+				append(pointer, i.key());
+				const std::size_t array_length = pointer.size();
+
 				std::size_t index = 0;
-				auto child_id = id.append(json_uri::escape(i.key()));
-				for (auto &v : i.value()) {
-					if (v.type() == json::value_t::object) // array element is object
-						resolve(v, child_id.append(std::to_string(index)));
+				for (const auto &v : i.value()) {
+					if (v.type() == json::value_t::object) { // array element is object
+						pointer += "/" + std::to_string(index);
+						resolve(v, base, pointer);
+						pointer.resize(array_length);
+					}
 					index++;
 				}
+				pointer.resize(length);
 			} break;
 
 			case json::value_t::string:
 				if (i.key() == "$ref") {
-					json_uri ref = id.derive(i.value());
-					i.value() = ref.to_string();
+					json_uri ref = here(base, pointer).derive(i.value());
+					absolute_refs[&schema] = ref.to_string();
 					refs.insert(ref);
 				}
 				break;
@@ -98,29 +182,77 @@ class resolver
 		}
 	}
 
+	// appends a key as escaped by json_uri::escape()
+	static void append(std::string &pointer, const std::string &key)
+	{
+		pointer += '/';
+		for (char c : key)
+			switch (c) {
+			case '~':
+				pointer += "~0";
+				break;
+			case '/':
+				pointer += "~1";
+				break;
+			case '%':
+				pointer += "%25";
+				break;
+			default:
+				pointer += c;
+				break;
+			}
+	}
+
+	static json_uri here(const json_uri &base, const std::string &pointer)
+	{
+		return pointer.empty() ? base : base.append(pointer.substr(1));
+	}
+
+	void add(const json_uri &id, const json &schema)
+	{
+		std::pair<std::string, std::string> key;
+		split_uri(id, key.first, key.second);
+
+		// already existing - error
+		if (!schema_refs.insert(std::make_pair(key, &schema)).second)
+			throw std::invalid_argument("schema " + id.to_string() + " already present in local resolver");
+	}
+
 	std::set<json_uri> refs;
 
 public:
 	std::set<json_uri> undefined_refs;
 
-	std::map<json_uri, const json *> schema_refs;
+	// registered schemas by location and pointer
+	std::map<std::pair<std::string, std::string>, const json *> schema_refs;
+
+	// the absolute URI of each $ref by the schema containing it
+	std::map<const json *, std::string> absolute_refs;
 
-	resolver(json &schema, json_uri id)
+	resolver(const json &schema, json_uri id)
 	{
 		// if schema has an id use it as name and to retrieve the namespace (URL)
 		auto fid = schema.find("id");
 		if (fid != schema.end())
 			id = id.derive(fid.value());
+		else
+			add(id, schema);
 
-		resolve(schema, id);
+		std::string pointer;
+		resolve(schema, id, pointer);
 
 		// refs now contains all references
 		//
 		// local references should be resolvable inside the same URL
 		//
 		// undefined_refs will only contain external references
-		for (auto r : refs) {
-			if (schema_refs.find(r) == schema_refs.end()) {
+		auto registered = [this](const std::string &location, const std::string &pointer) -> const json * {
+			auto it = schema_refs.find(std::make_pair(location, pointer));
+			return it != schema_refs.end() ? it->second : nullptr;
+		};
+
+		for (auto &r : refs) {
+			if (lookup_schema(r, registered) == nullptr) {
 				if (r.url() == id.url()) // same url means referencing a sub-schema
 				                         // of the same document, which has not been found
 					throw std::invalid_argument("sub-schema " + r.pointer().to_string() +
@@ -131,167 +263,244 @@ public:
 	}
 };
 
-void validate_type(const json &schema, const std::string &expected_type, const std::string &name)
+// structural hash of a json-value, consistent with json's operator==
+//
+// numbers compare equal by value regardless of their json-type, therefore they
+// are all hashed by their floating-point value
+std::size_t hash_value(const json &j)
 {
-	const auto &type_it = schema.find("type");
-	if (type_it == schema.end())
-		/* TODO something needs to be done here, I think */
-		return;
-
-	const auto &type_instance = type_it.value();
-
-	// any of the types in this array
-	if (type_instance.type() == json::value_t::array) {
-		if ((std::find(type_instance.begin(),
-		               type_instance.end(),
-		               expected_type) != type_instance.end()) ||
-		    (expected_type == "integer" &&
-		     std::find(type_instance.begin(),
-		               type_instance.end(),
-		               "number") != type_instance.end()))
-			return;
+	auto combine = [](std::size_t seed, std::size_t h) {
+		return seed ^ (h + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+	};
 
-		std::ostringstream s;
-		s << expected_type << " is not any of " << type_instance << " for " << name;
-		throw std::invalid_argument(s.str());
+	switch (j.type()) {
+	case json::value_t::null:
+		return 0;
 
-	} else { // type_instance is a string
-		if (type_instance == expected_type ||
-		    (type_instance == "number" && expected_type == "integer"))
-			return;
+	case json::value_t::boolean:
+		return combine(1, j.get<bool>());
 
-		throw std::invalid_argument(name + " is " + expected_type +
-		                            ", but required type is " + type_instance.get<std::string>());
+	case json::value_t::number_integer:
+	case json::value_t::number_unsigned:
+	case json::value_t::number_float: {
+		double d = j;
+		if (d == 0) // -0.0 == 0.0
+			d = 0;
+		return combine(2, std::hash<double>()(d));
 	}
-}
 
-void validate_enum(const json &instance, const json &schema, const std::string &name)
-{
-	const auto &enum_value = schema.find("enum");
-	if (enum_value == schema.end())
-		return;
+	case json::value_t::string:
+		return combine(3, std::hash<std::string>()(j.get_ref<const std::string &>()));
 
-	if (std::find(enum_value.value().begin(), enum_value.value().end(), instance) != enum_value.value().end())
-		return;
+	case json::value_t::array: {
+		std::size_t seed = 4;
+		for (const auto &v : j)
+			seed = combine(seed, hash_value(v));
+		return seed;
+	}
 
-	std::ostringstream s;
-	s << "invalid enum-value '" << instance << "' "
-	  << "for instance '" << name << "'. Candidates are " << enum_value.value() << ".";
+	case json::value_t::object: {
+		std::size_t seed = 5;
+		for (auto it = j.begin(); it != j.end(); ++it) {
+			seed = combine(seed, std::hash<std::string>()(it.key()));
+			seed = combine(seed, hash_value(it.value()));
+		}
+		return seed;
+	}
 
-	throw std::invalid_argument(s.str());
+	default:
+		return 6;
+	}
 }
 
-void validate_boolean(const json & /*instance*/, const json &schema, const std::string &name)
-{
-	validate_type(schema, "boolean", name);
-}
+// hash-set functors for referring to json-values and strings without copying them
+struct json_ptr_hash {
+	std::size_t operator()(const json *j) const { return hash_value(*j); }
+};
 
-template <class T>
-bool violates_numeric_maximum(T max, T value, bool exclusive)
-{
-	if (exclusive)
-		return value >= max;
+struct json_ptr_equal {
+	bool operator()(const json *a, const json *b) const { return *a == *b; }
+};
 
-	return value > max;
-}
+struct string_ptr_hash {
+	std::size_t operator()(const std::string *s) const { return std::hash<std::string>()(*s); }
+};
 
-template <class T>
-bool violates_numeric_minimum(T min, T value, bool exclusive)
-{
-	if (exclusive)
-		return value <= min;
+// instance-types as bits of a mask - type-keywords and keyword-groups are
+// compiled into masks of the types they apply to
+typedef uint16_t type_mask;
 
-	return value < min;
+type_mask type_bit(json::value_t type)
+{
+	return type_mask(1) << static_cast<unsigned>(type);
 }
 
-// multipleOf - if the rest of the division is 0 -> OK
-bool violates_multiple_of(json::number_float_t x, json::number_float_t y)
+const type_mask integer_types = type_bit(json::value_t::number_integer) | type_bit(json::value_t::number_unsigned);
+const type_mask number_types = integer_types | type_bit(json::value_t::number_float);
+
+struct string_ptr_equal {
+	bool operator()(const std::string *a, const std::string *b) const { return *a == *b; }
+};
+#ifndef NO_STD_REGEX
+// patterns are compiled once with the schema, invalid ones are reported when loading it
+REGEX_NAMESPACE::regex compile_regex(const std::string &pattern)
 {
-	json::number_integer_t n = static_cast<json::number_integer_t>(x / y);
-	double res = (x - n * y);
-	return fabs(res) > std::numeric_limits<json::number_float_t>::epsilon();
+	try {
+		return REGEX_NAMESPACE::regex(pattern, REGEX_NAMESPACE::regex::ECMAScript);
+	} catch (std::exception &e) {
+		throw std::invalid_argument("invalid regex pattern '" + pattern + "' in schema: " + e.what());
+	}
 }
+#endif
 
-template <class T>
-void validate_numeric(const json &instance, const json &schema, const std::string &name)
+// The patterns of a patternProperties-keyword, matched against a key at once.
+//
+// Patterns which are only a literal - maybe anchored with ^ and/or $ - are
+// compared as strings. All others are combined into one automaton if the
+// linear-time engine is used, otherwise they are searched one by one.
+class pattern_matcher
 {
-	T value = instance;
-
-	if (value != 0) { // zero is multiple of everything
-		const auto &multipleOf = schema.find("multipleOf");
+	struct literal {
+		std::string text;
+		std::size_t index;
+	};
+
+	std::vector<literal> exact_; // sorted by text
+	std::vector<literal> prefixes_;
+	std::vector<literal> suffixes_;
+	std::vector<literal> infixes_;
+
+#ifdef JSON_SCHEMA_LINEAR_REGEX
+	REGEX_NAMESPACE::regex_set set_;
+	std::vector<std::size_t> set_index_;
+#elif !defined(NO_STD_REGEX)
+	std::vector<std::pair<REGEX_NAMESPACE::regex, std::size_t>> regexes_;
+#else
+	bool has_regexes_ = false;
+#endif
 
-		if (multipleOf != schema.end()) {
-			double multiple = multipleOf.value();
-			double value_float = value;
+	std::size_t size_ = 0;
 
-			if (violates_multiple_of(value_float, multiple))
-				throw std::out_of_range(name + " is not a multiple of " + std::to_string(multiple));
+	// the text of a pattern without any regex-operators, escaped
+	// punctuation is taken literally
+	static bool is_literal(const std::string &pattern, std::size_t begin, std::size_t end, std::string &text)
+	{
+		static const std::string operators = "\\^$.|?*+()[]{}";
+
+		for (std::size_t i = begin; i < end; i++) {
+			char c = pattern[i];
+			if (c == '\\') {
+				if (++i == end || (operators.find(pattern[i]) == std::string::npos && pattern[i] != '/' && pattern[i] != '-'))
+					return false;
+				c = pattern[i];
+			} else if (operators.find(c) != std::string::npos)
+				return false;
+			text += c;
 		}
+		return true;
 	}
 
-	const auto &maximum = schema.find("maximum");
-	if (maximum != schema.end()) {
-		T maxi = maximum.value();
-
-		const auto &excl = schema.find("exclusiveMaximum");
-		bool exclusive = (excl != schema.end()) ? excl.value().get<bool>() : false;
-
-		if (violates_numeric_maximum<T>(maxi, value, exclusive))
-			throw std::out_of_range(name + " exceeds maximum of " + std::to_string(maxi));
+	static bool ends_with(const std::string &s, const std::string &suffix)
+	{
+		return s.size() >= suffix.size() &&
+		       s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
 	}
 
-	const auto &minimum = schema.find("minimum");
-	if (minimum != schema.end()) {
-		T mini = minimum.value();
-
-		const auto &excl = schema.find("exclusiveMinimum");
-		bool exclusive = (excl != schema.end()) ? excl.value().get<bool>() : false;
+public:
+	void add(const std::string &pattern)
+	{
+		const std::size_t index = size_++;
+
+		// a $ at the end anchors the pattern unless it is escaped
+		std::size_t begin = 0, end = pattern.size();
+		const bool head = end > 0 && pattern[0] == '^';
+		bool tail = end > begin + head && pattern[end - 1] == '$';
+		if (tail) {
+			std::size_t backslashes = 0;
+			while (backslashes + 1 < end && pattern[end - 2 - backslashes] == '\\')
+				backslashes++;
+			tail = backslashes % 2 == 0;
+		}
+		begin += head;
+		end -= tail;
+
+		std::string text;
+		if (is_literal(pattern, begin, end, text)) {
+			literal l{text, index};
+			if (head && tail)
+				exact_.insert(std::upper_bound(exact_.begin(), exact_.end(), l,
+				                               [](const literal &a, const literal &b) { return a.text < b.text; }),
+				              l);
+			else if (head)
+				prefixes_.push_back(l);
+			else if (tail)
+				suffixes_.push_back(l);
+			else
+				infixes_.push_back(l);
+			return;
+		}
 
-		if (violates_numeric_minimum<T>(mini, value, exclusive))
-			throw std::out_of_range(name + " is below minimum of " + std::to_string(mini));
+#ifdef JSON_SCHEMA_LINEAR_REGEX
+		try {
+			set_.add(pattern);
+		} catch (std::exception &e) {
+			throw std::invalid_argument("invalid regex pattern '" + pattern + "' in schema: " + e.what());
+		}
+		set_index_.push_back(index);
+#elif !defined(NO_STD_REGEX)
+		regexes_.push_back(std::make_pair(compile_regex(pattern), index));
+#else
+		has_regexes_ = true;
+#endif
 	}
-}
-
-void validate_integer(const json &instance, const json &schema, const std::string &name)
-{
-	validate_type(schema, "integer", name);
-	//TODO: Validate schema values are json::value_t::number_integer/unsigned?
-
-	validate_numeric<int64_t>(instance, schema, name);
-}
-
-bool is_unsigned(const json &schema)
-{
-	const auto &minimum = schema.find("minimum");
-
-	// Number is expected to be unsigned if a minimum >= 0 is set
-	return minimum != schema.end() && minimum.value() >= 0;
-}
-
-void validate_unsigned(const json &instance, const json &schema, const std::string &name)
-{
-	validate_type(schema, "integer", name);
-	//TODO: Validate schema values are json::value_t::unsigned?
-
-	//Is there a better way to determine whether an unsigned comparison should take place?
-	if (is_unsigned(schema))
-		validate_numeric<uint64_t>(instance, schema, name);
-	else
-		validate_numeric<int64_t>(instance, schema, name);
-}
 
-void validate_float(const json &instance, const json &schema, const std::string &name)
-{
-	validate_type(schema, "number", name);
-	//TODO: Validate schema values are json::value_t::number_float?
+	bool empty() const { return size_ == 0; }
 
-	validate_numeric<double>(instance, schema, name);
-}
+	// fills matches with the indexes of all patterns matching key in
+	// ascending order, true if any matched. Without regex-support, any
+	// non-literal pattern is taken as matching without being listed.
+	bool match(const std::string &key, std::vector<std::size_t> &matches) const
+	{
+		matches.clear();
+
+		auto range = std::equal_range(exact_.begin(), exact_.end(), literal{key, 0},
+		                              [](const literal &a, const literal &b) { return a.text < b.text; });
+		for (auto l = range.first; l != range.second; ++l)
+			matches.push_back(l->index);
+
+		for (const auto &l : prefixes_)
+			if (key.compare(0, l.text.size(), l.text) == 0)
+				matches.push_back(l.index);
+
+		for (const auto &l : suffixes_)
+			if (ends_with(key, l.text))
+				matches.push_back(l.index);
+
+		for (const auto &l : infixes_)
+			if (key.find(l.text) != std::string::npos)
+				matches.push_back(l.index);
+
+#ifdef JSON_SCHEMA_LINEAR_REGEX
+		if (set_.size()) {
+			std::vector<bool> matched;
+			set_.search(key, matched);
+			for (std::size_t i = 0; i < matched.size(); i++)
+				if (matched[i])
+					matches.push_back(set_index_[i]);
+		}
+#elif !defined(NO_STD_REGEX)
+		for (const auto &re : regexes_)
+			if (REGEX_NAMESPACE::regex_search(key, re.first))
+				matches.push_back(re.second);
+#else
+		if (has_regexes_)
+			return true;
+#endif
 
-void validate_null(const json & /*instance*/, const json &schema, const std::string &name)
-{
-	validate_type(schema, "null", name);
-}
+		std::sort(matches.begin(), matches.end());
+		return !matches.empty();
+	}
+};
 
 } // anonymous namespace
 
@@ -300,483 +509,2080 @@ namespace nlohmann
 namespace json_schema_draft4
 {
 
-void json_validator::insert_schema(const json &input, const json_uri &id)
+// A compiled (sub-)schema.
+//
+// All keywords are looked up and converted once in json_validator::compile(),
+// keywords which are specific to one instance-type are grouped and only
+// allocated when at least one of them is present in the schema.
+class schema
 {
-	// allocate create a copy for later storage - if resolving reference works
-	std::shared_ptr<json> schema = std::make_shared<json>(input);
+public:
+	// $ref - all other keywords are ignored, the referenced schema is linked
+	// when compiling, chains of $refs are followed to their end
+	bool has_ref = false;
+	std::string ref;                // absolute URI, for error-messages
+	const schema *target = nullptr; // the first schema of the chain without a $ref
+
+	// enum - values are hashed by type for O(1) lookups
+	struct enum_keyword {
+		const json *values = nullptr; // original enum-array, for error-messages
+
+		std::unordered_set<const std::string *, string_ptr_hash, string_ptr_equal> strings;
+		std::unordered_set<json::number_integer_t> integers;
+		std::unordered_set<const json *, json_ptr_hash, json_ptr_equal> others; // including non-integer numbers
+
+		bool contains(const json &instance) const
+		{
+			switch (instance.type()) {
+			case json::value_t::string:
+				return strings.count(&instance.get_ref<const std::string &>()) > 0;
 
-	do {
-		// resolve all local schemas and references
-		resolver r(*schema, id);
+			case json::value_t::number_integer:
+				if (integers.count(instance.get<json::number_integer_t>()))
+					return true;
+				break;
 
-		// check whether all undefined schema references can be resolved with existing ones
-		std::set<json_uri> undefined;
-		for (auto &ref : r.undefined_refs)
-			if (schema_refs_.find(ref) == schema_refs_.end()) // exact schema reference not found
-				undefined.insert(ref);
+			case json::value_t::number_unsigned:
+				if (instance.get<json::number_unsigned_t>() <= static_cast<json::number_unsigned_t>(std::numeric_limits<json::number_integer_t>::max()) &&
+				    integers.count(instance.get<json::number_integer_t>()))
+					return true;
+				break;
 
-		if (undefined.size() == 0) { // no undefined references
-			// now insert all schema-references
-			// check whether all schema-references are new
-			for (auto &sref : r.schema_refs) {
-				if (schema_refs_.find(sref.first) != schema_refs_.end())
-					throw std::invalid_argument("schema " + sref.first.to_string() + " already present in validator.");
-			}
-			// no undefined references and no duplicated schema - store the schema
-			schema_store_.push_back(schema);
+			case json::value_t::number_float: { // 1.0 equals 1
+				json::number_float_t d = instance;
+				if (d >= std::numeric_limits<json::number_integer_t>::min() &&
+				    d < -static_cast<json::number_float_t>(std::numeric_limits<json::number_integer_t>::min()) &&
+				    d == static_cast<json::number_integer_t>(d) &&
+				    integers.count(static_cast<json::number_integer_t>(d)))
+					return true;
+			} break;
 
-			// and insert all references
-			schema_refs_.insert(r.schema_refs.begin(), r.schema_refs.end());
+			default:
+				break;
+			}
 
-			break;
+			return others.count(&instance) > 0;
+		}
+	};
+	std::unique_ptr<enum_keyword> enum_;
+
+	const json *type_json = nullptr; // original type-keyword, for error-messages
+	type_mask type = 0;
+
+	// the instance-types for which a keyword-group is present
+	type_mask keyword_types = 0;
+
+	const schema *not_ = nullptr;
+	std::vector<const schema *> all_of;
+	std::vector<const schema *> any_of;
+	std::vector<const schema *> one_of;
+
+	// anyOf and oneOf whose branches all pin a property to distinct enum-values,
+	// or accept distinct instance-types, are indexed by them: the branches an
+	// instance cannot match fail without being evaluated
+	struct discriminator {
+		std::string property;                       // the pinned property, if any
+		std::map<json, std::size_t> values;         // its values, to their branch
+		std::map<json::value_t, std::size_t> types; // instance-types, to their branch
+
+		// the only branch an instance can match - npos if all of them have to be evaluated
+		std::size_t branch(const json &instance) const
+		{
+			if (!property.empty() && instance.is_object()) {
+				auto value = instance.find(property);
+				if (value != instance.end()) {
+					auto it = values.find(*value);
+					return it == values.end() ? std::string::npos : it->second;
+				}
+			}
+			return branch(instance.type());
 		}
 
-		if (schema_loader_ == nullptr)
-			throw std::invalid_argument("schema contains undefined references to other schemas, needed schema-loader.");
+		std::size_t branch(json::value_t type) const
+		{
+			if (type == json::value_t::number_unsigned)
+				type = json::value_t::number_integer;
 
-		for (auto undef : undefined) {
-			json ext;
+			auto it = types.find(type);
+			return it == types.end() ? std::string::npos : it->second;
+		}
+	};
+	std::unique_ptr<discriminator> any_of_discriminator;
+	std::unique_ptr<discriminator> one_of_discriminator;
+
+	struct numeric_keywords {
+		bool has_multiple_of = false;
+		double multiple_of = 0;
+		json::number_unsigned_t integer_multiple_of = 0; // if the divisor is an integer, for exact checks of integers
+
+		// maximum and minimum in the representation they were given in, an
+		// instance is compared with them exactly
+		struct bound {
+			const json *value = nullptr; // original keyword, for error-messages
+			bool exclusive = false;
+
+			json::value_t type = json::value_t::null;
+			json::number_integer_t integer = 0;
+			json::number_unsigned_t unsigned_integer = 0;
+			json::number_float_t number = 0;
+		};
+		bound maximum;
+		bound minimum;
+	};
 
-			// check whether a recursive-call has already insert this schema in the meantime
-			if (schema_refs_.find(undef) != schema_refs_.end())
-				continue;
+	struct string_keywords {
+		std::size_t min_length = 0;
+		std::size_t max_length = std::numeric_limits<std::size_t>::max();
 
-			schema_loader_(undef, ext);
-			insert_schema(ext, undef.url()); // recursively call insert_schema to fill in new external references
-		}
-	} while (1);
+		bool has_pattern = false;
+		std::string pattern;
+#ifndef NO_STD_REGEX
+		REGEX_NAMESPACE::regex pattern_re;
+#endif
 
-	// store the document root-schema
-	if (id == json_uri("#"))
-		root_schema_ = schema;
-}
+		bool has_format = false;
+		std::string format;
+		format_checker format_check; // resolved from the registry, empty if there is none
+	};
+
+	struct array_keywords {
+		std::size_t max_items = std::numeric_limits<std::size_t>::max();
+		std::size_t min_items = 0;
+		bool unique_items = false;
+
+		const schema *items = nullptr;           // items is a schema for all elements
+		bool items_is_tuple = false;             // items is an array of schemas
+		std::vector<const schema *> items_tuple; //
+
+		enum {
+			True,
+			False,
+			Object
+		} additional_items = True;
+		const schema *additional_items_schema = nullptr;
+	};
+
+	struct object_keywords {
+		std::size_t max_properties = std::numeric_limits<std::size_t>::max();
+		std::size_t min_properties = 0;
+
+		// all property-names the schema knows about, from properties, required
+		// and dependencies, sorted by name - like the keys of a json-object
+		//
+		// names used by required and dependencies have a slot in a presence-bitset
+		// which is filled in the same pass over the instance
+		struct property {
+			std::string name;
+			const schema *sub_schema = nullptr; // from properties
+			std::size_t slot = std::string::npos;
+		};
+		std::vector<property> properties;
+		std::size_t slot_words = 0;
+
+		// sub-schemas of patternProperties, indexed like the patterns of the matcher
+		std::vector<const schema *> pattern_properties;
+		pattern_matcher patterns;
+
+		enum {
+			True,
+			False,
+			Object
+		} additional_properties = True;
+		const schema *additional_properties_schema = nullptr;
+
+		struct slot_name {
+			std::string name;
+			std::size_t slot;
+		};
 
-void json_validator::validate(const json &instance)
-{
-	if (root_schema_ == nullptr)
-		throw std::invalid_argument("no root-schema has been inserted. Cannot validate an instance without it.");
+		std::vector<slot_name> required;
+		std::vector<uint64_t> required_mask;
 
-	validate(instance, *root_schema_, "root");
-}
+		struct dependency {
+			slot_name property;
+			std::vector<slot_name> properties; // array-form
+			std::vector<uint64_t> mask;        //
+			const schema *sub_schema = nullptr; // schema-form
+		};
+		std::vector<dependency> dependencies;
+	};
 
-void json_validator::set_root_schema(const json &schema)
-{
-	insert_schema(schema, json_uri("#"));
-}
+	std::unique_ptr<numeric_keywords> numeric;
+	std::unique_ptr<string_keywords> string;
+	std::unique_ptr<array_keywords> array;
+	std::unique_ptr<object_keywords> object;
+};
 
-void json_validator::validate(const json &instance, const json &schema_, const std::string &name)
+// Position of the instance-element currently validated.
+//
+// Each level is a stack-object referring to its parent and to the key or
+// index of the element, it is only turned into a string (an URI-fragment
+// JSON pointer) when an error is reported.
+class instance_path
 {
-	const json *schema = &schema_;
-
-	// $ref resolution
-	do {
-		const auto &ref = schema->find("$ref");
-		if (ref == schema->end())
-			break;
+	const instance_path *parent_ = nullptr;
+	const std::string *key_ = nullptr;
+	std::size_t index_ = 0;
 
-		auto it = schema_refs_.find(ref.value().get<std::string>());
+public:
+	instance_path() {} // the root of the instance
 
-		if (it == schema_refs_.end())
-			throw std::invalid_argument("schema reference " + ref.value().get<std::string>() + " not found. Make sure all schemas have been inserted before validation.");
+	instance_path(const instance_path &parent, const std::string &key)
+	    : parent_(&parent), key_(&key) {}
 
-		schema = it->second;
-	} while (1); // loop in case of nested refs
+	instance_path(const instance_path &parent, std::size_t index)
+	    : parent_(&parent), index_(index) {}
 
-	// not
-	const auto attr = schema->find("not");
-	if (attr != schema->end()) {
-		bool ok;
+	std::string to_string() const
+	{
+		if (parent_ == nullptr)
+			return "#";
 
-		try {
-			validate(instance, attr.value(), name);
-			ok = false;
-		} catch (std::exception &) {
-			ok = true;
-		}
-		if (!ok)
-			throw std::invalid_argument("schema match for " + name + " but a not-match is defined by schema.");
-		return; // return here - not cannot be mixed with based-schemas?
+		std::string s = parent_->to_string();
+		s += '/';
+		if (key_)
+			s += json_uri::escape(*key_);
+		else
+			s += std::to_string(index_);
+		return s;
 	}
+};
 
-	// allOf, anyOf, oneOf
-	const json *combined_schemas = nullptr;
-	enum {
-		none,
-		allOf,
-		anyOf,
-		oneOf
-	} combine_logic = none;
+} // namespace json_schema_draft4
+} // namespace nlohmann
 
+using nlohmann::json_schema_draft4::instance_path;
+using nlohmann::json_schema_draft4::schema;
+
+namespace
+{
+
+// throws the first error reported - used by the exception-based validate()
+class throwing_error_handler : public nlohmann::json_schema_draft4::basic_error_handler
+{
+	void error(const std::string &path, const json & /*instance*/, const std::string &message) override
 	{
-		const auto &attr = schema->find("allOf");
-		if (attr != schema->end()) {
-			combine_logic = allOf;
-			combined_schemas = &attr.value();
-		}
-	}
-	{
-		const auto &attr = schema->find("anyOf");
-		if (attr != schema->end()) {
-			combine_logic = anyOf;
-			combined_schemas = &attr.value();
-		}
-	}
-	{
-		const auto &attr = schema->find("oneOf");
-		if (attr != schema->end()) {
-			combine_logic = oneOf;
-			combined_schemas = &attr.value();
-		}
+		throw std::invalid_argument("At " + path + " - " + message);
 	}
+};
 
-	if (combine_logic != none) {
-		std::size_t count = 0;
-		std::ostringstream sub_schema_err;
-
-		for (const auto &s : *combined_schemas) {
-			try {
-				validate(instance, s, name);
-				count++;
-			} catch (std::exception &e) {
-				sub_schema_err << "  one schema failed because: " << e.what() << "\n";
+// remembers the first error reported - used to evaluate sub-schemas of not, allOf, anyOf and oneOf
+class first_error_handler : public nlohmann::json_schema_draft4::basic_error_handler
+{
+public:
+	std::string path;
+	std::string message;
 
-				if (combine_logic == allOf)
-					throw std::out_of_range("At least one schema has failed for " + name + " where allOf them were requested.\n" + sub_schema_err.str());
-			}
-			if (combine_logic == oneOf && count > 1)
-				throw std::out_of_range("More than one schema has succeeded for " + name + " where only oneOf them was requested.\n" + sub_schema_err.str());
+	void error(const std::string &path, const json &instance, const std::string &message) override
+	{
+		if (!*this) {
+			this->path = path;
+			this->message = message;
 		}
-		if ((combine_logic == anyOf || combine_logic == oneOf) && count == 0)
-			throw std::out_of_range("No schema has succeeded for " + name + " but anyOf/oneOf them should have worked.\n" + sub_schema_err.str());
+		basic_error_handler::error(path, instance, message);
 	}
+};
 
-	// check (base) schema
-	validate_enum(instance, *schema, name);
+void report(nlohmann::json_schema_draft4::basic_error_handler &e, const instance_path &path, const json &instance, const std::string &message)
+{
+	e.error(path.to_string(), instance, message);
+}
 
-	switch (instance.type()) {
-	case json::value_t::object:
-		validate_object(instance, *schema, name);
-		break;
+type_mask types_from_name(const std::string &name)
+{
+	static const std::map<std::string, type_mask> types = {
+	    {"null", type_bit(json::value_t::null)},
+	    {"boolean", type_bit(json::value_t::boolean)},
+	    {"object", type_bit(json::value_t::object)},
+	    {"array", type_bit(json::value_t::array)},
+	    {"string", type_bit(json::value_t::string)},
+	    {"integer", integer_types},
+	    {"number", number_types},
+	};
+
+	auto type = types.find(name);
+	if (type == types.end())
+		return 0; // unknown type-names never match
+
+	return type->second;
+}
 
+// name of the schema-type an instance-type is checked against
+const char *type_name(json::value_t type)
+{
+	switch (type) {
+	case json::value_t::null:
+		return "null";
+	case json::value_t::boolean:
+		return "boolean";
+	case json::value_t::object:
+		return "object";
 	case json::value_t::array:
-		validate_array(instance, *schema, name);
-		break;
-
+		return "array";
 	case json::value_t::string:
-		validate_string(instance, *schema, name);
-		break;
-
-	case json::value_t::number_unsigned:
-		validate_unsigned(instance, *schema, name);
-		break;
-
+		return "string";
 	case json::value_t::number_integer:
-		validate_integer(instance, *schema, name);
-		break;
-
+	case json::value_t::number_unsigned:
+		return "integer";
 	case json::value_t::number_float:
-		validate_float(instance, *schema, name);
-		break;
-
-	case json::value_t::boolean:
-		validate_boolean(instance, *schema, name);
-		break;
-
-	case json::value_t::null:
-		validate_null(instance, *schema, name);
-		break;
-
+		return "number";
 	default:
-		assert(0 && "unexpected instance type for validation");
-		break;
+		return "unknown";
 	}
 }
 
-void json_validator::validate_array(const json &instance, const json &schema, const std::string &name)
+void validate_type(const schema &sch, const json &instance, const instance_path &path, nlohmann::json_schema_draft4::basic_error_handler &e)
 {
-	validate_type(schema, "array", name);
+	if (sch.type_json == nullptr)
+		/* TODO something needs to be done here, I think */
+		return;
 
-	// maxItems
-	const auto &maxItems = schema.find("maxItems");
-	if (maxItems != schema.end())
-		if (instance.size() > maxItems.value().get<size_t>())
-			throw std::out_of_range(name + " has too many items.");
+	if (sch.type & type_bit(instance.type()))
+		return;
 
-	// minItems
-	const auto &minItems = schema.find("minItems");
-	if (minItems != schema.end())
-		if (instance.size() < minItems.value().get<size_t>())
-			throw std::out_of_range(name + " has too few items.");
+	json::value_t expected_type = instance.type();
+	if (expected_type == json::value_t::number_unsigned)
+		expected_type = json::value_t::number_integer;
 
-	// uniqueItems
-	const auto &uniqueItems = schema.find("uniqueItems");
-	if (uniqueItems != schema.end())
-		if (uniqueItems.value().get<bool>() == true) {
-			std::set<json> array_to_set;
-			for (auto v : instance) {
-				auto ret = array_to_set.insert(v);
-				if (ret.second == false)
-					throw std::out_of_range(name + " should have only unique items.");
-			}
+	// any of the types in this array
+	if (sch.type_json->type() == json::value_t::array) {
+		std::ostringstream s;
+		s << "instance type " << type_name(expected_type) << " is not any of " << *sch.type_json;
+		report(e, path, instance, s.str());
+	} else { // type_json is a string
+		report(e, path, instance, std::string("instance is ") + type_name(expected_type) +
+		                              ", but required type is " + sch.type_json->get<std::string>());
+	}
+}
+
+void validate_enum(const json &instance, const schema &sch, const instance_path &path, nlohmann::json_schema_draft4::basic_error_handler &e)
+{
+	if (sch.enum_ == nullptr)
+		return;
+
+	if (sch.enum_->contains(instance))
+		return;
+
+	std::ostringstream s;
+	s << "invalid enum-value '" << instance << "'. Candidates are " << *sch.enum_->values << ".";
+
+	report(e, path, instance, s.str());
+}
+
+// three-way comparison of numbers of different representations, exact
+// unless both are floating point
+int compare_numbers(json::number_integer_t a, json::number_integer_t b)
+{
+	return (a > b) - (a < b);
+}
+
+int compare_numbers(json::number_unsigned_t a, json::number_unsigned_t b)
+{
+	return (a > b) - (a < b);
+}
+
+int compare_numbers(json::number_float_t a, json::number_float_t b)
+{
+	return (a > b) - (a < b);
+}
+
+int compare_numbers(json::number_integer_t a, json::number_unsigned_t b)
+{
+	return a < 0 ? -1 : compare_numbers(static_cast<json::number_unsigned_t>(a), b);
+}
+
+int compare_numbers(json::number_unsigned_t a, json::number_integer_t b)
+{
+	return -compare_numbers(b, a);
+}
+
+template <class Integer>
+int compare_numbers(Integer a, json::number_float_t b)
+{
+	// beyond the range of the integer-type
+	if (b >= static_cast<json::number_float_t>(std::numeric_limits<Integer>::max()))
+		return -1;
+	if (b < static_cast<json::number_float_t>(std::numeric_limits<Integer>::min()))
+		return 1;
+
+	// compare with the integral part, which is representable, then with the fraction
+	const json::number_float_t integral = std::trunc(b);
+	const Integer i = static_cast<Integer>(integral);
+	if (a != i)
+		return a < i ? -1 : 1;
+
+	return (integral > b) - (integral < b);
+}
+
+template <class Integer>
+int compare_numbers(json::number_float_t a, Integer b)
+{
+	return -compare_numbers(b, a);
+}
+
+template <class T>
+int compare_to_bound(T value, const schema::numeric_keywords::bound &bound)
+{
+	switch (bound.type) {
+	case json::value_t::number_integer:
+		return compare_numbers(value, bound.integer);
+	case json::value_t::number_unsigned:
+		return compare_numbers(value, bound.unsigned_integer);
+	default:
+		return compare_numbers(value, bound.number);
+	}
+}
+
+schema::numeric_keywords::bound compile_bound(const json &value, const json::const_iterator &exclusive, const json::const_iterator &end)
+{
+	schema::numeric_keywords::bound bound;
+
+	bound.value = &value;
+	bound.exclusive = (exclusive != end) ? exclusive.value().get<bool>() : false;
+	bound.type = value.type();
+
+	switch (bound.type) {
+	case json::value_t::number_integer:
+		bound.integer = value;
+		break;
+	case json::value_t::number_unsigned:
+		bound.unsigned_integer = value;
+		break;
+	default:
+		bound.type = json::value_t::number_float;
+		bound.number = value;
+		break;
+	}
+	return bound;
+}
+
+// multipleOf - if the rest of the division is 0 -> OK
+bool violates_multiple_of(json::number_float_t x, json::number_float_t y)
+{
+	json::number_integer_t n = static_cast<json::number_integer_t>(x / y);
+	double res = (x - n * y);
+	return fabs(res) > std::numeric_limits<json::number_float_t>::epsilon();
+}
+
+bool violates_multiple_of(json::number_float_t value, const schema::numeric_keywords &numeric)
+{
+	return violates_multiple_of(value, numeric.multiple_of);
+}
+
+// integers by integer-divisors exactly, without going through floating point
+bool violates_multiple_of(json::number_unsigned_t value, const schema::numeric_keywords &numeric)
+{
+	if (numeric.integer_multiple_of)
+		return value % numeric.integer_multiple_of != 0;
+
+	return violates_multiple_of(static_cast<json::number_float_t>(value), numeric.multiple_of);
+}
+
+bool violates_multiple_of(json::number_integer_t value, const schema::numeric_keywords &numeric)
+{
+	if (numeric.integer_multiple_of) // the magnitude of the smallest integer is representable unsigned
+		return (value < 0 ? 0 - static_cast<json::number_unsigned_t>(value) : value) % numeric.integer_multiple_of != 0;
+
+	return violates_multiple_of(static_cast<json::number_float_t>(value), numeric.multiple_of);
+}
+
+template <class T>
+void validate_numeric(const json &instance, const schema::numeric_keywords &numeric, const instance_path &path, nlohmann::json_schema_draft4::basic_error_handler &e)
+{
+	const T value = instance.get<T>();
+
+	if (value != 0) { // zero is multiple of everything
+		if (numeric.has_multiple_of && violates_multiple_of(value, numeric))
+			report(e, path, instance, "instance is not a multiple of " + std::to_string(numeric.multiple_of));
+	}
+
+	if (numeric.maximum.value) {
+		const int c = compare_to_bound(value, numeric.maximum);
+
+		if (c > 0 || (c == 0 && numeric.maximum.exclusive))
+			report(e, path, instance, "instance exceeds maximum of " + numeric.maximum.value->dump());
+	}
+
+	if (numeric.minimum.value) {
+		const int c = compare_to_bound(value, numeric.minimum);
+
+		if (c < 0 || (c == 0 && numeric.minimum.exclusive))
+			report(e, path, instance, "instance is below minimum of " + numeric.minimum.value->dump());
+	}
+}
+
+template <class Key, class Hash, class Equal, class Get>
+bool all_unique(const json &array, Get get)
+{
+	std::unordered_set<Key, Hash, Equal> seen;
+	seen.reserve(array.size());
+
+	for (const auto &v : array)
+		if (!seen.insert(get(v)).second)
+			return false;
+
+	return true;
+}
+
+// uniqueItems - O(n) with a hash-set referring to the elements,
+// arrays of only strings or only numbers of one type are checked without a
+// generic json-comparison
+bool has_unique_items(const json &array)
+{
+	if (array.size() < 2)
+		return true;
+
+	const auto type = array.front().type();
+	bool same_type = true;
+	for (const auto &v : array)
+		if (v.type() != type) {
+			same_type = false;
+			break;
+		}
+
+	if (same_type)
+		switch (type) {
+		case json::value_t::string:
+			return all_unique<const std::string *, string_ptr_hash, string_ptr_equal>(
+			    array, [](const json &v) { return &v.get_ref<const std::string &>(); });
+
+		case json::value_t::number_integer:
+			return all_unique<json::number_integer_t, std::hash<json::number_integer_t>, std::equal_to<json::number_integer_t>>(
+			    array, [](const json &v) { return v.get<json::number_integer_t>(); });
+
+		case json::value_t::number_unsigned:
+			return all_unique<json::number_unsigned_t, std::hash<json::number_unsigned_t>, std::equal_to<json::number_unsigned_t>>(
+			    array, [](const json &v) { return v.get<json::number_unsigned_t>(); });
+
+		case json::value_t::number_float:
+			return all_unique<json::number_float_t, std::hash<json::number_float_t>, std::equal_to<json::number_float_t>>(
+			    array, [](const json &v) {
+				    json::number_float_t d = v;
+				    return d == 0 ? 0 : d; // -0.0 == 0.0
+			    });
+
+		default:
+			break;
 		}
 
-	// items and additionalItems
-	// default to empty schemas
-	auto items_iter = schema.find("items");
-	json items = {};
-	if (items_iter != schema.end())
-		items = items_iter.value();
+	return all_unique<const json *, json_ptr_hash, json_ptr_equal>(
+	    array, [](const json &v) { return &v; });
+}
+
+// the number of code-points of an UTF-8-string is the number of bytes which
+// are not continuation-bytes (10xxxxxx) - as signed chars, those are below -64
+std::size_t utf8_length_scalar(const char *s, std::size_t n)
+{
+	std::size_t len = 0;
+	for (std::size_t i = 0; i < n; i++)
+		if ((static_cast<unsigned char>(s[i]) & 0xc0) != 0x80)
+			len++;
+	return len;
+}
+
+#ifdef UTF8_SSE2
+unsigned popcount(uint32_t x)
+{
+ #ifdef __GNUC__
+	return __builtin_popcount(x);
+ #else
+	x = x - ((x >> 1) & 0x55555555);
+	x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+	return (((x + (x >> 4)) & 0x0f0f0f0f) * 0x01010101) >> 24;
+ #endif
+}
+
+std::size_t utf8_length_sse2(const char *s, std::size_t n)
+{
+	const __m128i continuation = _mm_set1_epi8(-65);
+	std::size_t len = 0, i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+		len += popcount(_mm_movemask_epi8(_mm_cmpgt_epi8(bytes, continuation)));
+	}
+	return len + utf8_length_scalar(s + i, n - i);
+}
+#endif
+
+#ifdef UTF8_AVX2
+__attribute__((target("avx2"))) std::size_t utf8_length_avx2(const char *s, std::size_t n)
+{
+	const __m256i continuation = _mm256_set1_epi8(-65);
+	std::size_t len = 0, i = 0;
+
+	for (; i + 32 <= n; i += 32) {
+		const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + i));
+		len += popcount(_mm256_movemask_epi8(_mm256_cmpgt_epi8(bytes, continuation)));
+	}
+	return len + utf8_length_sse2(s + i, n - i);
+}
+#endif
+
+std::size_t utf8_length(const std::string &s)
+{
+	typedef std::size_t (*kernel)(const char *, std::size_t);
+
+	static const kernel count =
+#if defined(UTF8_AVX2)
+	    __builtin_cpu_supports("avx2") ? utf8_length_avx2 : utf8_length_sse2;
+#elif defined(UTF8_SSE2)
+	    utf8_length_sse2;
+#else
+	    utf8_length_scalar;
+#endif
+
+	return count(s.data(), s.size());
+}
+
+// bitset of the properties present in an object-instance, indexed by the
+// slots of object_keywords - small sets live on the stack
+class presence_set
+{
+	uint64_t local_[4] = {};
+	std::vector<uint64_t> heap_;
+	uint64_t *words_;
+
+public:
+	explicit presence_set(std::size_t words)
+	    : words_(local_)
+	{
+		if (words > 4) {
+			heap_.resize(words);
+			words_ = heap_.data();
+		}
+	}
+
+	presence_set(const presence_set &) = delete;
+	presence_set &operator=(const presence_set &) = delete;
+
+	void set(std::size_t slot) { words_[slot / 64] |= uint64_t(1) << (slot % 64); }
+	bool test(std::size_t slot) const { return words_[slot / 64] & (uint64_t(1) << (slot % 64)); }
+
+	bool contains(const std::vector<uint64_t> &mask) const
+	{
+		for (std::size_t i = 0; i < mask.size(); i++)
+			if ((words_[i] & mask[i]) != mask[i])
+				return false;
+		return true;
+	}
+};
+
+enum combine_logic {
+	allOf,
+	anyOf,
+	oneOf
+};
+
+} // anonymous namespace
+
+namespace nlohmann
+{
+namespace json_schema_draft4
+{
+
+void json_validator::insert_schema(std::shared_ptr<const json> schema, const json_uri &id)
+{
+	do {
+		// resolve all local schemas and references
+		resolver r(*schema, id);
+
+		// check whether all undefined schema references can be resolved with existing ones
+		std::set<json_uri> undefined;
+		for (auto &ref : r.undefined_refs)
+			if (schema_->find_schema(ref) == nullptr) // schema reference not found
+				undefined.insert(ref);
+
+		if (undefined.size() == 0) { // no undefined references
+			// now insert all schema-references
+			// check whether all schema-references are new
+			for (auto &sref : r.schema_refs) {
+				if (schema_->registered(sref.first.first, sref.first.second))
+					throw std::invalid_argument("schema " + sref.first.first + sref.first.second + " already present in validator.");
+			}
+			// no undefined references and no duplicated schema - store the schema
+			schema_->schema_store_.push_back(schema);
+
+			// and insert all references
+			for (auto &sref : r.schema_refs)
+				schema_->register_schema(sref.first.first, sref.first.second, sref.second);
+			for (auto &ref : r.absolute_refs)
+				schema_->absolute_refs_[ref.first] = std::move(ref.second);
+
+			break;
+		}
+
+		if (schema_loader_ == nullptr && async_loader_ == nullptr)
+			throw std::invalid_argument("schema contains undefined references to other schemas, needed schema-loader.");
+
+		for (auto undef : undefined) {
+			// check whether a recursive-call has already insert this schema in the meantime
+			if (schema_->find_schema(undef))
+				continue;
+
+			insert_schema(load(undef), undef.url()); // recursively call insert_schema to fill in new external references
+		}
+	} while (1);
+
+	// store the document root-schema
+	if (id == json_uri("#"))
+		root_schema_ = schema;
+}
+
+std::shared_ptr<const json> json_validator::load(const json_uri &url)
+{
+	auto fetched = prefetched_.find(url);
+	if (fetched != prefetched_.end()) {
+		auto schema = fetched->second;
+		prefetched_.erase(fetched);
+		return schema;
+	}
+
+	if (async_loader_)
+		return std::make_shared<json>(async_loader_(url).get());
+
+	json ext;
+	schema_loader_(url, ext);
+	return std::make_shared<json>(std::move(ext));
+}
+
+void json_validator::prefetch(const json &schema, const json_uri &id)
+{
+	std::set<json_uri> requested;
+	std::deque<json_uri> wanted;
+	std::list<std::pair<json_uri, std::future<json>>> pending;
+
+	auto discover = [&](const json &document, const json_uri &url) {
+		resolver r(document, url);
+		for (auto &ref : r.undefined_refs)
+			if (requested.insert(ref).second && schema_->find_schema(ref) == nullptr)
+				wanted.push_back(ref);
+	};
+
+	discover(schema, id);
+
+	while (!wanted.empty() || !pending.empty()) {
+		while (!wanted.empty() && pending.size() < max_pending_) {
+			pending.emplace_back(wanted.front(), async_loader_(wanted.front()));
+			wanted.pop_front();
+		}
+
+		// continue with whichever request completes first, the futures are
+		// polled as there is no way to wait for any of them
+		auto done = pending.end();
+		while (done == pending.end()) {
+			for (auto p = pending.begin(); p != pending.end() && done == pending.end(); ++p)
+				if (p->second.wait_for(std::chrono::seconds(0)) != std::future_status::timeout)
+					done = p;
+
+			if (done == pending.end())
+				pending.front().second.wait_for(std::chrono::milliseconds(1));
+		}
+
+		auto document = std::make_shared<const json>(done->second.get());
+		discover(*document, done->first.url());
+
+		prefetched_[done->first] = document;
+		pending.erase(done);
+	}
+}
+
+const json *compiled_schema::registered(const std::string &location, const std::string &pointer) const
+{
+	auto l = locations_.find(location);
+	if (l == locations_.end())
+		return nullptr;
+
+	auto it = schema_refs_.find(std::make_pair(l->second, pointer));
+	return it != schema_refs_.end() ? it->second : nullptr;
+}
+
+void compiled_schema::register_schema(const std::string &location, const std::string &pointer, const json *schema)
+{
+	auto l = locations_.insert(std::make_pair(location, locations_.size())).first;
+	schema_refs_[std::make_pair(l->second, pointer)] = schema;
+}
+
+const json *compiled_schema::find_schema(const json_uri &uri)
+{
+	const json *schema = lookup_schema(uri, [this](const std::string &location, const std::string &pointer) {
+		return registered(location, pointer);
+	});
+
+	// $ref-targets are looked up once, when compiling
+	if (schema) {
+		std::string location, pointer;
+		split_uri(uri, location, pointer);
+		register_schema(location, pointer, schema);
+	}
+
+	return schema;
+}
+
+const schema *compiled_schema::compile(const json &input)
+{
+	auto known = compiled_.find(&input);
+	if (known != compiled_.end())
+		return known->second.get();
+
+	// register before compiling the keywords, recursive schemas will find themselves
+	auto sch = std::make_shared<schema>();
+	compiled_[&input] = sch;
+
+	// $ref - ignore all other keywords, but make sure the referenced schema is compiled as well
+	auto attr = input.find("$ref");
+	if (attr != input.end()) {
+		auto absolute = absolute_refs_.find(&input);
+
+		sch->has_ref = true;
+		sch->ref = absolute != absolute_refs_.end() ? absolute->second : attr.value().get<std::string>();
+
+		const json *target = find_schema(sch->ref);
+		if (target == nullptr)
+			throw std::invalid_argument("schema reference " + sch->ref + " not found. Make sure all schemas have been inserted before validation.");
+
+		// the target may still be being compiled in case of a recursive
+		// schema - it is registered already, link_refs() follows the chain
+		sch->target = compile(*target);
+		return sch.get();
+	}
+
+	attr = input.find("enum");
+	if (attr != input.end()) {
+		sch->enum_.reset(new schema::enum_keyword);
+		sch->enum_->values = &attr.value();
+
+		for (const auto &v : attr.value()) {
+			switch (v.type()) {
+			case json::value_t::string:
+				sch->enum_->strings.insert(&v.get_ref<const std::string &>());
+				break;
+
+			case json::value_t::number_integer:
+				sch->enum_->integers.insert(v.get<json::number_integer_t>());
+				break;
+
+			case json::value_t::number_unsigned:
+				if (v.get<json::number_unsigned_t>() <= static_cast<json::number_unsigned_t>(std::numeric_limits<json::number_integer_t>::max()))
+					sch->enum_->integers.insert(v.get<json::number_integer_t>());
+				else
+					sch->enum_->others.insert(&v);
+				break;
+
+			default:
+				sch->enum_->others.insert(&v);
+				break;
+			}
+		}
+	}
+
+	attr = input.find("type");
+	if (attr != input.end()) {
+		sch->type_json = &attr.value();
+
+		if (attr.value().type() == json::value_t::array) {
+			for (const auto &t : attr.value())
+				sch->type |= types_from_name(t);
+		} else
+			sch->type = types_from_name(attr.value());
+	}
+
+	attr = input.find("not");
+	if (attr != input.end())
+		sch->not_ = compile(attr.value());
+
+	attr = input.find("allOf");
+	if (attr != input.end())
+		for (const auto &s : attr.value())
+			sch->all_of.push_back(compile(s));
+
+	attr = input.find("anyOf");
+	if (attr != input.end())
+		for (const auto &s : attr.value())
+			sch->any_of.push_back(compile(s));
+
+	attr = input.find("oneOf");
+	if (attr != input.end())
+		for (const auto &s : attr.value())
+			sch->one_of.push_back(compile(s));
+
+	// numeric keywords
+	{
+		const auto &multipleOf = input.find("multipleOf");
+		const auto &maximum = input.find("maximum");
+		const auto &minimum = input.find("minimum");
+
+		if (multipleOf != input.end() || maximum != input.end() || minimum != input.end()) {
+			sch->numeric.reset(new schema::numeric_keywords);
+
+			if (multipleOf != input.end()) {
+				sch->numeric->has_multiple_of = true;
+				sch->numeric->multiple_of = multipleOf.value();
+
+				const json::number_float_t d = sch->numeric->multiple_of;
+				if (multipleOf.value().is_number_unsigned())
+					sch->numeric->integer_multiple_of = multipleOf.value();
+				else if (d >= 1 && d < 18446744073709551616.0 && d == std::trunc(d)) // an integral float below 2^64
+					sch->numeric->integer_multiple_of = static_cast<json::number_unsigned_t>(d);
+			}
+
+			if (maximum != input.end())
+				sch->numeric->maximum = compile_bound(maximum.value(), input.find("exclusiveMaximum"), input.end());
+
+			if (minimum != input.end())
+				sch->numeric->minimum = compile_bound(minimum.value(), input.find("exclusiveMinimum"), input.end());
+		}
+	}
+
+	// string keywords
+	{
+		const auto &minLength = input.find("minLength");
+		const auto &maxLength = input.find("maxLength");
+		const auto &pattern = input.find("pattern");
+		const auto &format = input.find("format");
+
+		if (minLength != input.end() || maxLength != input.end() ||
+		    pattern != input.end() || format != input.end()) {
+			sch->string.reset(new schema::string_keywords);
+
+			if (minLength != input.end())
+				sch->string->min_length = minLength.value().get<std::size_t>();
+
+			if (maxLength != input.end())
+				sch->string->max_length = maxLength.value().get<std::size_t>();
+
+			if (pattern != input.end()) {
+				sch->string->has_pattern = true;
+				sch->string->pattern = pattern.value().get<std::string>();
+#ifndef NO_STD_REGEX
+				sch->string->pattern_re = compile_regex(sch->string->pattern);
+#endif
+			}
+
+			if (format != input.end()) {
+				auto &string = *sch->string;
+				string.has_format = true;
+				string.format = format.value().get<std::string>();
+
+				if (const format_checker *checker = formats_.find(string.format))
+					string.format_check = *checker;
+				else if (format_check_) {
+					const auto legacy = format_check_;
+					const auto name = string.format;
+					string.format_check = [legacy, name](const std::string &value) { legacy(name, value); };
+				} else if (!formats_.empty())
+					throw std::invalid_argument("unknown format '" + string.format + "' in schema, no format-checker is registered for it");
+			}
+		}
+	}
+
+	// array keywords
+	{
+		const auto &maxItems = input.find("maxItems");
+		const auto &minItems = input.find("minItems");
+		const auto &uniqueItems = input.find("uniqueItems");
+		const auto &items = input.find("items");
+
+		if (maxItems != input.end() || minItems != input.end() ||
+		    uniqueItems != input.end() || items != input.end()) {
+			sch->array.reset(new schema::array_keywords);
+			auto &array = *sch->array;
+
+			if (maxItems != input.end())
+				array.max_items = maxItems.value().get<std::size_t>();
+
+			if (minItems != input.end())
+				array.min_items = minItems.value().get<std::size_t>();
+
+			if (uniqueItems != input.end())
+				array.unique_items = uniqueItems.value().get<bool>();
+
+			if (items != input.end()) {
+				switch (items.value().type()) {
+				case json::value_t::array: // items is an array
+					                         // we need to take into consideration additionalItems
+					array.items_is_tuple = true;
+					for (const auto &s : items.value())
+						array.items_tuple.push_back(compile(s));
+
+					{
+						const auto &additionalItems = input.find("additionalItems");
+						if (additionalItems != input.end()) {
+							switch (additionalItems.value().type()) {
+							case json::value_t::object:
+								array.additional_items = schema::array_keywords::Object;
+								array.additional_items_schema = compile(additionalItems.value());
+								break;
+
+							case json::value_t::boolean:
+								array.additional_items = additionalItems.value().get<bool>() ? schema::array_keywords::True : schema::array_keywords::False;
+								break;
+
+							default:
+								break;
+							}
+						}
+					}
+					break;
+
+				case json::value_t::object: // items is a schema
+					array.items = compile(items.value());
+					break;
+
+				default:
+					break;
+				}
+			}
+		}
+	}
+
+	// object keywords
+	{
+		const auto &maxProperties = input.find("maxProperties");
+		const auto &minProperties = input.find("minProperties");
+		const auto &properties = input.find("properties");
+		const auto &patternProperties = input.find("patternProperties");
+		const auto &additionalProperties = input.find("additionalProperties");
+		const auto &required = input.find("required");
+		const auto &dependencies = input.find("dependencies");
+
+		if (maxProperties != input.end() || minProperties != input.end() ||
+		    properties != input.end() || patternProperties != input.end() ||
+		    additionalProperties != input.end() || required != input.end() ||
+		    dependencies != input.end()) {
+			sch->object.reset(new schema::object_keywords);
+			auto &object = *sch->object;
+
+			if (maxProperties != input.end())
+				object.max_properties = maxProperties.value().get<std::size_t>();
+
+			if (minProperties != input.end())
+				object.min_properties = minProperties.value().get<std::size_t>();
+
+			// collect all property-names first, the table is created from them when complete
+			std::map<std::string, schema::object_keywords::property> names;
+
+			if (properties != input.end() && properties.value().type() == json::value_t::object)
+				for (auto prop = properties.value().begin(); prop != properties.value().end(); ++prop) {
+					names[prop.key()].name = prop.key();
+					names[prop.key()].sub_schema = compile(prop.value());
+				}
+
+			if (patternProperties != input.end() && patternProperties.value().type() == json::value_t::object)
+				for (auto pp = patternProperties.value().begin(); pp != patternProperties.value().end(); ++pp) {
+					object.patterns.add(pp.key());
+					object.pattern_properties.push_back(compile(pp.value()));
+				}
+
+			if (additionalProperties != input.end()) {
+				if (additionalProperties.value().type() == json::value_t::boolean)
+					object.additional_properties = additionalProperties.value().get<bool>() ? schema::object_keywords::True : schema::object_keywords::False;
+				else {
+					object.additional_properties = schema::object_keywords::Object;
+					object.additional_properties_schema = compile(additionalProperties.value());
+				}
+			}
+
+			std::size_t slots = 0;
+			auto slot_of = [&names, &slots](const std::string &name) {
+				auto &prop = names[name];
+				if (prop.slot == std::string::npos) {
+					prop.name = name;
+					prop.slot = slots++;
+				}
+				return schema::object_keywords::slot_name{name, prop.slot};
+			};
+
+			if (required != input.end())
+				for (const auto &element : required.value())
+					object.required.push_back(slot_of(element));
+
+			if (dependencies != input.end() && dependencies.value().type() == json::value_t::object)
+				for (auto dep = dependencies.value().begin(); dep != dependencies.value().end(); ++dep) {
+					schema::object_keywords::dependency d;
+					d.property = slot_of(dep.key());
+
+					switch (dep.value().type()) {
+					case json::value_t::object:
+						d.sub_schema = compile(dep.value());
+						break;
+
+					case json::value_t::array:
+						for (const auto &prop : dep.value())
+							d.properties.push_back(slot_of(prop));
+						break;
+
+					default:
+						continue;
+					}
+
+					object.dependencies.push_back(d);
+				}
+
+			for (const auto &n : names)
+				object.properties.push_back(n.second);
+
+			// all slots are known, create the masks
+			object.slot_words = (slots + 63) / 64;
+
+			auto mask_of = [&object](const std::vector<schema::object_keywords::slot_name> &names) {
+				std::vector<uint64_t> mask(object.slot_words);
+				for (const auto &n : names)
+					mask[n.slot / 64] |= uint64_t(1) << (n.slot % 64);
+				return mask;
+			};
+
+			object.required_mask = mask_of(object.required);
+			for (auto &d : object.dependencies)
+				d.mask = mask_of(d.properties);
+		}
+	}
+
+	if (sch->numeric)
+		sch->keyword_types |= number_types;
+	if (sch->string)
+		sch->keyword_types |= type_bit(json::value_t::string);
+	if (sch->array)
+		sch->keyword_types |= type_bit(json::value_t::array);
+	if (sch->object)
+		sch->keyword_types |= type_bit(json::value_t::object);
+
+	return sch.get();
+}
+
+void compiled_schema::link_refs()
+{
+	for (auto &c : compiled_) {
+		schema &sch = *c.second;
+		if (!sch.has_ref || !sch.target->has_ref)
+			continue;
+
+		// a chain of $refs - more than the number of schemas is a cycle
+		const schema *target = sch.target;
+		for (std::size_t n = 0; target->has_ref; n++) {
+			if (n == compiled_.size())
+				throw std::invalid_argument("schema reference " + sch.ref + " is circular, it never reaches a schema.");
+			target = target->target;
+		}
+		sch.target = target;
+	}
+}
+
+void compiled_schema::index_branches()
+{
+	auto discriminate = [this](const std::vector<const schema *> &branches) -> std::unique_ptr<schema::discriminator> {
+		if (branches.size() < 2)
+			return nullptr;
+
+		std::vector<const schema *> resolved;
+		for (const auto branch : branches)
+			resolved.push_back(resolve_refs(*branch));
+
+		std::unique_ptr<schema::discriminator> d(new schema::discriminator);
+
+		// a property which has an enum in all branches, with values distinct between them
+		if (resolved[0]->object)
+			for (const auto &candidate : resolved[0]->object->properties) {
+				bool pinned = candidate.sub_schema != nullptr;
+				d->values.clear();
+
+				for (std::size_t i = 0; pinned && i < resolved.size(); i++) {
+					pinned = false;
+					if (!resolved[i]->object)
+						break;
+
+					const auto &properties = resolved[i]->object->properties;
+					auto prop = std::lower_bound(properties.cbegin(), properties.cend(), candidate.name,
+					                             [](const schema::object_keywords::property &p, const std::string &name) { return p.name < name; });
+					if (prop == properties.cend() || prop->name != candidate.name || !prop->sub_schema)
+						break;
+
+					const schema *value = resolve_refs(*prop->sub_schema);
+					if (!value->enum_)
+						break;
+
+					pinned = true;
+					for (const auto &v : *value->enum_->values)
+						if (d->values.emplace(v, i).first->second != i)
+							pinned = false;
+				}
+
+				if (pinned) {
+					d->property = candidate.name;
+					break;
+				}
+			}
+
+		if (d->property.empty())
+			d->values.clear();
+
+		// types distinct between all branches
+		bool typed = true;
+		for (std::size_t i = 0; typed && i < resolved.size(); i++) {
+			if (!resolved[i]->type_json) {
+				typed = false;
+				break;
+			}
+
+			for (const auto t : {json::value_t::null, json::value_t::boolean, json::value_t::object, json::value_t::array,
+			                     json::value_t::string, json::value_t::number_integer, json::value_t::number_float})
+				if (resolved[i]->type & type_bit(t))
+					typed &= d->types.emplace(t, i).first->second == i;
+		}
+
+		if (!typed)
+			d->types.clear();
+
+		if (d->property.empty() && d->types.empty())
+			return nullptr;
+		return d;
+	};
+
+	for (auto &compiled : compiled_) {
+		compiled.second->any_of_discriminator = discriminate(compiled.second->any_of);
+		compiled.second->one_of_discriminator = discriminate(compiled.second->one_of);
+	}
+}
+
+void compiled_schema::validate(const json &instance) const
+{
+	throwing_error_handler e;
+	validate(instance, e);
+}
+
+void compiled_schema::validate(const json &instance, basic_error_handler &e) const
+{
+	if (root_ == nullptr)
+		throw std::invalid_argument("no root-schema has been inserted. Cannot validate an instance without it.");
+
+	validate(instance, *root_, instance_path(), e);
+}
+
+void json_validator::set_root_schema(const json &schema)
+{
+	set_root_schema(std::make_shared<json>(schema));
+}
+
+void json_validator::set_root_schema(json &&schema)
+{
+	set_root_schema(std::make_shared<json>(std::move(schema)));
+}
+
+void json_validator::set_root_schema(std::shared_ptr<const json> schema)
+{
+	prefetched_.clear();
+	if (async_loader_)
+		prefetch(*schema, json_uri("#"));
+
+	insert_schema(std::move(schema), json_uri("#"));
+	prefetched_.clear();
+
+	// all referenced schemas are inserted now, compile the root-schema
+	// and everything reachable from it
+	schema_->root_ = schema_->compile(*root_schema_);
+	schema_->link_refs();
+	schema_->index_branches();
+}
+
+void json_validator::validate(const json &instance) const
+{
+	schema_->validate(instance);
+}
+
+void json_validator::validate(const json &instance, basic_error_handler &e) const
+{
+	schema_->validate(instance, e);
+}
+
+std::vector<batch_result> json_validator::validate_batch(const std::vector<json> &instances, unsigned threads) const
+{
+	return schema_->validate_batch(instances, threads);
+}
+
+std::vector<batch_result> json_validator::validate_batch(const std::function<bool(json &)> &source, unsigned threads) const
+{
+	return schema_->validate_batch(source, threads);
+}
+
+void json_validator::validate_stream(std::istream &stream, basic_error_handler &e) const
+{
+	schema_->validate_stream(stream, e);
+}
+
+const schema *compiled_schema::resolve_refs(const schema &schema_) const
+{
+	return schema_.has_ref ? schema_.target : &schema_;
+}
+
+void compiled_schema::validate(const json &instance, const schema &schema_, const instance_path &path, basic_error_handler &e) const
+{
+	// $ref resolution
+	const schema *sch = resolve_refs(schema_);
+
+	// not
+	if (sch->not_) {
+		first_error_handler not_err;
+		validate(instance, *sch->not_, path, not_err);
+
+		if (!not_err)
+			report(e, path, instance, "schema match but a not-match is defined by schema.");
+	}
+
+	// allOf, anyOf, oneOf
+	const std::tuple<combine_logic, const std::vector<const schema *> *, const schema::discriminator *> combinations[] = {
+	    std::make_tuple(allOf, &sch->all_of, nullptr),
+	    std::make_tuple(anyOf, &sch->any_of, sch->any_of_discriminator.get()),
+	    std::make_tuple(oneOf, &sch->one_of, sch->one_of_discriminator.get())};
+
+	for (const auto &combination : combinations) {
+		const auto combine_logic = std::get<0>(combination);
+		const auto &combined_schemas = *std::get<1>(combination);
+		const auto discriminator = std::get<2>(combination);
+
+		if (combined_schemas.empty())
+			continue;
+
+		// when only one branch can match, all others fail - evaluating them
+		// is only needed for the error-message when none can match
+		const std::size_t only = discriminator ? discriminator->branch(instance) : std::string::npos;
+
+		std::size_t count = 0;
+		std::ostringstream sub_schema_err;
+
+		for (std::size_t i = 0; i < combined_schemas.size(); i++) {
+			if (only != std::string::npos && i != only)
+				continue;
+
+			first_error_handler sub_err;
+			validate(instance, *combined_schemas[i], path, sub_err);
+
+			if (sub_err) {
+				sub_schema_err << "  one schema failed because: At " << sub_err.path << " - " << sub_err.message << "\n";
+
+				if (combine_logic == allOf) {
+					report(e, path, instance, "At least one schema has failed where allOf them were requested.\n" + sub_schema_err.str());
+					break;
+				}
+			} else {
+				count++;
+
+				if (combine_logic == anyOf)
+					break;
+			}
+
+			if (combine_logic == oneOf && count > 1) {
+				report(e, path, instance, "More than one schema has succeeded where only oneOf them was requested.\n" + sub_schema_err.str());
+				break;
+			}
+		}
+		if ((combine_logic == anyOf || combine_logic == oneOf) && count == 0)
+			report(e, path, instance, "No schema has succeeded but anyOf/oneOf them should have worked.\n" + sub_schema_err.str());
+	}
+
+	// check (base) schema
+	validate_enum(instance, *sch, path, e);
+	validate_type(*sch, instance, path, e);
+
+	// none of the keyword-groups applies to this type
+	if (!(sch->keyword_types & type_bit(instance.type())))
+		return;
+
+	switch (instance.type()) {
+	case json::value_t::object:
+		if (sch->object)
+			validate_object(instance, *sch, path, e);
+		break;
+
+	case json::value_t::array:
+		if (sch->array)
+			validate_array(instance, *sch, path, e);
+		break;
 
-	auto additionalItems_iter = schema.find("additionalItems");
-	json additionalItems = {};
-	if (additionalItems_iter != schema.end())
-		additionalItems = additionalItems_iter.value();
+	case json::value_t::string:
+		if (sch->string)
+			validate_string(instance, *sch, path, e);
+		break;
 
-	size_t i = 0;
-	bool validation_done = false;
+	case json::value_t::number_unsigned:
+		if (sch->numeric)
+			validate_numeric<json::number_unsigned_t>(instance, *sch->numeric, path, e);
+		break;
 
-	for (auto &value : instance) {
-		std::string sub_name = name + "[" + std::to_string(i) + "]";
+	case json::value_t::number_integer:
+		if (sch->numeric)
+			validate_numeric<json::number_integer_t>(instance, *sch->numeric, path, e);
+		break;
 
-		switch (items.type()) {
+	case json::value_t::number_float:
+		if (sch->numeric)
+			validate_numeric<json::number_float_t>(instance, *sch->numeric, path, e);
+		break;
 
-		case json::value_t::array:
+	case json::value_t::boolean:
+	case json::value_t::null:
+		break;
+
+	default:
+		assert(0 && "unexpected instance type for validation");
+		break;
+	}
+}
+
+void compiled_schema::validate_array(const json &instance, const schema &sch, const instance_path &path, basic_error_handler &e) const
+{
+	const auto &array = *sch.array;
+
+	// maxItems
+	if (instance.size() > array.max_items)
+		report(e, path, instance, "array has too many items.");
+
+	// minItems
+	if (instance.size() < array.min_items)
+		report(e, path, instance, "array has too few items.");
+
+	// uniqueItems
+	if (array.unique_items && !has_unique_items(instance))
+		report(e, path, instance, "array should have only unique items.");
+
+	// items and additionalItems
+	size_t i = 0;
+
+	for (auto &value : instance) {
+		const instance_path sub_path(path, i);
 
-			if (i < items.size())
-				validate(value, items[i], sub_name);
+		if (array.items_is_tuple) {
+			if (i < array.items_tuple.size())
+				validate(value, *array.items_tuple[i], sub_path, e);
 			else {
-				switch (additionalItems.type()) { // items is an array
-					                                // we need to take into consideration additionalItems
-				case json::value_t::object:
-					validate(value, additionalItems, sub_name);
+				bool validation_done = false;
+
+				switch (array.additional_items) {
+				case schema::array_keywords::Object:
+					validate(value, *array.additional_items_schema, sub_path, e);
 					break;
 
-				case json::value_t::boolean:
-					if (additionalItems.get<bool>() == false)
-						throw std::out_of_range("additional values in array are not allowed for " + sub_name);
-					else
-						validation_done = true;
+				case schema::array_keywords::False:
+					report(e, sub_path, value, "additional values in array are not allowed");
+					validation_done = true;
 					break;
 
-				default:
+				case schema::array_keywords::True:
+					validation_done = true;
 					break;
 				}
-			}
-
-			break;
-
-		case json::value_t::object: // items is a schema
-			validate(value, items, sub_name);
-			break;
 
-		default:
-			break;
-		}
-		if (validation_done)
+				if (validation_done)
+					break;
+			}
+		} else if (array.items) // items is a schema
+			validate(value, *array.items, sub_path, e);
+		else
 			break;
 
 		i++;
 	}
 }
 
-void json_validator::validate_object(const json &instance, const json &schema, const std::string &name)
+void compiled_schema::validate_object(const json &instance, const schema &sch, const instance_path &path, basic_error_handler &e) const
 {
-	validate_type(schema, "object", name);
-
-	json properties = {};
-	if (schema.find("properties") != schema.end())
-		properties = schema["properties"];
-
-#if 0
-	// check for default values of properties
-	// and insert them into this object, if they don't exists
-	// works only for object properties for the moment
-	if (default_value_insertion)
-		for (auto it = properties.begin(); it != properties.end(); ++it) {
-
-			const auto &default_value = it.value().find("default");
-			if (default_value == it.value().end())
-				continue; /* no default value -> continue */
+	const auto &object = *sch.object;
 
-			if (instance.find(it.key()) != instance.end())
-				continue; /* value is present */
-
-			/* create element from default value */
-			instance[it.key()] = default_value.value();
-		}
-#endif
 	// maxProperties
-	const auto &maxProperties = schema.find("maxProperties");
-	if (maxProperties != schema.end())
-		if (instance.size() > maxProperties.value().get<size_t>())
-			throw std::out_of_range(name + " has too many properties.");
+	if (instance.size() > object.max_properties)
+		report(e, path, instance, "object has too many properties.");
 
 	// minProperties
-	const auto &minProperties = schema.find("minProperties");
-	if (minProperties != schema.end())
-		if (instance.size() < minProperties.value().get<size_t>())
-			throw std::out_of_range(name + " has too few properties.");
-
-	// additionalProperties
-	enum {
-		True,
-		False,
-		Object
-	} additionalProperties = True;
-
-	const auto &additionalPropertiesVal = schema.find("additionalProperties");
-	if (additionalPropertiesVal != schema.end()) {
-		if (additionalPropertiesVal.value().type() == json::value_t::boolean)
-			additionalProperties = additionalPropertiesVal.value().get<bool>() == true ? True : False;
-		else
-			additionalProperties = Object;
-	}
+	if (instance.size() < object.min_properties)
+		report(e, path, instance, "object has too few properties.");
+
+	presence_set present(object.slot_words);
 
-	// patternProperties
-	json patternProperties = {};
-	if (schema.find("patternProperties") != schema.end())
-		patternProperties = schema["patternProperties"];
+	// the keys of a json-object are sorted, as is the property-table: they are
+	// matched with a merge-join, with a binary search instead of a linear
+	// scan for skipping through tables which are much larger than the instance
+	auto prop = object.properties.cbegin();
+	const auto props_end = object.properties.cend();
+	const bool skip_by_search = object.properties.size() > 8 * instance.size();
+
+	std::vector<std::size_t> matches; // patternProperties matching a key
 
 	// check all elements in object
 	for (auto child = instance.begin(); child != instance.end(); ++child) {
-		std::string child_name = name + "." + child.key();
+		const instance_path child_path(path, child.key());
+
+		if (skip_by_search)
+			prop = std::lower_bound(prop, props_end, child.key(),
+			                        [](const schema::object_keywords::property &p, const std::string &key) { return p.name < key; });
+		else
+			while (prop != props_end && prop->name < child.key())
+				++prop;
 
 		bool property_or_patternProperties_has_validated = false;
-		// is this a property which is described in the schema
-		const auto &object_prop = properties.find(child.key());
-		if (object_prop != properties.end()) {
-			// validate the element with its schema
-			validate(child.value(), object_prop.value(), child_name);
-			property_or_patternProperties_has_validated = true;
-		}
 
-		for (auto pp = patternProperties.begin();
-		     pp != patternProperties.end(); ++pp) {
-#ifndef NO_STD_REGEX
-			REGEX_NAMESPACE::regex re(pp.key(), REGEX_NAMESPACE::regex::ECMAScript);
+		if (prop != props_end && prop->name == child.key()) {
+			if (prop->slot != std::string::npos)
+				present.set(prop->slot);
 
-			if (REGEX_NAMESPACE::regex_search(child.key(), re)) {
-				validate(child.value(), pp.value(), child_name);
+			// is this a property which is described in the schema
+			if (prop->sub_schema) {
+				// validate the element with its schema
+				validate(child.value(), *prop->sub_schema, child_path, e);
 				property_or_patternProperties_has_validated = true;
 			}
-#else
-			// accept everything in case of a patternProperty
+		}
+
+		if (!object.patterns.empty() && object.patterns.match(child.key(), matches)) {
+			for (auto i : matches)
+				validate(child.value(), *object.pattern_properties[i], child_path, e);
 			property_or_patternProperties_has_validated = true;
-			break;
-#endif
 		}
 
 		if (property_or_patternProperties_has_validated)
 			continue;
 
-		switch (additionalProperties) {
-		case True:
+		switch (object.additional_properties) {
+		case schema::object_keywords::True:
 			break;
 
-		case Object:
-			validate(child.value(), additionalPropertiesVal.value(), child_name);
+		case schema::object_keywords::Object:
+			validate(child.value(), *object.additional_properties_schema, child_path, e);
 			break;
 
-		case False:
-			throw std::invalid_argument("unknown property '" + child.key() + "' in object '" + name + "'");
+		case schema::object_keywords::False:
+			report(e, child_path, child.value(), "unknown property '" + child.key() + "' in object");
 			break;
 		};
 	}
 
 	// required
-	const auto &required = schema.find("required");
-	if (required != schema.end())
-		for (const auto &element : required.value()) {
-			if (instance.find(element) == instance.end()) {
-				throw std::invalid_argument("required element '" + element.get<std::string>() +
-				                            "' not found in object '" + name + "'");
-			}
-		}
+	if (!present.contains(object.required_mask))
+		for (const auto &element : object.required)
+			if (!present.test(element.slot))
+				report(e, path, instance, "required property '" + element.name + "' not found in object");
 
 	// dependencies
-	const auto &dependencies = schema.find("dependencies");
-	if (dependencies == schema.end())
-		return;
-
-	for (auto dep = dependencies.value().cbegin();
-	     dep != dependencies.value().cend();
-	     ++dep) {
+	for (const auto &dep : object.dependencies) {
 
 		// property not present in this instance - next
-		if (instance.find(dep.key()) == instance.end())
+		if (!present.test(dep.property.slot))
 			continue;
 
-		std::string sub_name = name + ".dependency-of-" + dep.key();
-
-		switch (dep.value().type()) {
-
-		case json::value_t::object:
-			validate(instance, dep.value(), sub_name);
-			break;
-
-		case json::value_t::array:
-			for (const auto &prop : dep.value())
-				if (instance.find(prop) == instance.end())
-					throw std::invalid_argument("failed dependency for " + sub_name + ". Need property " + prop.get<std::string>());
-			break;
+		if (dep.sub_schema)
+			validate(instance, *dep.sub_schema, path, e);
 
-		default:
-			break;
-		}
+		if (!present.contains(dep.mask))
+			for (const auto &prop : dep.properties)
+				if (!present.test(prop.slot))
+					report(e, path, instance, "failed dependency for '" + dep.property.name + "'. Need property '" + prop.name + "'");
 	}
 }
 
-static std::size_t utf8_length(const std::string &s)
+void compiled_schema::validate_string(const json &instance, const schema &sch, const instance_path &path, basic_error_handler &e) const
 {
-	size_t len = 0;
-	for (const unsigned char &c : s)
-		if ((c & 0xc0) != 0x80)
-			len++;
-	return len;
-}
+	const auto &string = *sch.string;
 
-void json_validator::validate_string(const json &instance, const json &schema, const std::string &name)
-{
-	validate_type(schema, "string", name);
+	// a code-point has 1 to 4 bytes: the length in bytes often decides
+	// minLength and maxLength, otherwise the code-points are counted once
+	const auto &value = instance.get_ref<const std::string &>();
+	const std::size_t most = value.size(), least = (value.size() + 3) / 4;
+	std::size_t length = std::string::npos; // not counted
 
 	// minLength
-	auto attr = schema.find("minLength");
-	if (attr != schema.end())
-		if (utf8_length(instance) < attr.value().get<size_t>()) {
+	if (string.min_length > least) {
+		if (most >= string.min_length)
+			length = utf8_length(value);
+
+		if (std::min(length, most) < string.min_length) {
 			std::ostringstream s;
-			s << "'" << name << "' of value '" << instance << "' is too short as per minLength ("
-			  << attr.value() << ")";
-			throw std::out_of_range(s.str());
+			s << "instance is too short as per minLength ("
+			  << string.min_length << ")";
+			report(e, path, instance, s.str());
 		}
+	}
 
 	// maxLength
-	attr = schema.find("maxLength");
-	if (attr != schema.end())
-		if (utf8_length(instance) > attr.value().get<size_t>()) {
+	if (string.max_length < most) {
+		if (least <= string.max_length && length == std::string::npos)
+			length = utf8_length(value);
+
+		if (length > string.max_length) {
 			std::ostringstream s;
-			s << "'" << name << "' of value '" << instance << "' is too long as per maxLength ("
-			  << attr.value() << ")";
-			throw std::out_of_range(s.str());
+			s << "instance is too long as per maxLength ("
+			  << string.max_length << ")";
+			report(e, path, instance, s.str());
 		}
+	}
 
 #ifndef NO_STD_REGEX
 	// pattern
-	attr = schema.find("pattern");
-	if (attr != schema.end()) {
-		REGEX_NAMESPACE::regex re(attr.value().get<std::string>(), REGEX_NAMESPACE::regex::ECMAScript);
-		if (!REGEX_NAMESPACE::regex_search(instance.get<std::string>(), re))
-			throw std::invalid_argument(instance.get<std::string>() + " does not match regex pattern: " + attr.value().get<std::string>() + " for " + name);
+	if (string.has_pattern) {
+		if (!REGEX_NAMESPACE::regex_search(instance.get_ref<const std::string &>(), string.pattern_re))
+			report(e, path, instance, "instance does not match regex pattern: " + string.pattern);
 	}
 #endif
 
 	// format
-	attr = schema.find("format");
-	if (attr != schema.end()) {
-		if (format_check_ == nullptr)
+	if (string.has_format) {
+		if (!string.format_check)
 			throw std::logic_error("A format checker was not provided but a format-attribute for this string is present. " +
-			                       name + " cannot be validated for " + attr.value().get<std::string>());
-		format_check_(attr.value(), instance);
+			                       path.to_string() + " cannot be validated for " + string.format);
+
+		// format-checkers report invalid values by throwing
+		try {
+			string.format_check(value);
+		} catch (const std::exception &ex) {
+			report(e, path, instance, ex.what());
+		}
+	}
+}
+
+void compiled_schema::validate_stream(std::istream &stream, basic_error_handler &e) const
+{
+	sax_validator validator(*this, e);
+
+	if (!json::sax_parse(stream, &validator))
+		throw std::invalid_argument("document cannot be parsed: " + validator.parse_error_message());
+}
+
+// Each open object or array is a frame. When it starts, the schemas it has to
+// be validated against are expanded into what can be evaluated while its
+// members arrive: the type at once, properties and items for each member,
+// counts, required and dependencies when it ends. The sub-schemas of not,
+// allOf, anyOf, oneOf and of schema-dependencies are evaluated in the same
+// pass, each reporting to its own branch-handler - those are combined when
+// the frame ends. Scalars are validated as a whole by the DOM-validator.
+struct sax_validator::impl {
+	// a schema to be evaluated on a value, and where to report its errors
+	struct check {
+		const schema *sch;
+		basic_error_handler *e;
+	};
+
+	// the object- or array-keywords of a schema evaluated on an open container
+	struct container_check {
+		const schema *sch;
+		basic_error_handler *e;
+		std::unique_ptr<presence_set> present;               // objects
+		std::vector<first_error_handler *> dependency_errors; // objects, one per schema-dependency
+		bool additional_items_reported = false;              // arrays
+	};
+
+	// evaluated in order when the frame ends - branches are always opened
+	// before what combines them, so inner results are available to outer ones
+	struct finalizer {
+		enum {
+			collected,  // sch is validated on the collected value
+			container,  // end of checks[index]
+			not_,       // branches[0]
+			combination // logic over branches
+		} kind;
+		const schema *sch = nullptr;
+		basic_error_handler *e = nullptr;
+		std::size_t index = 0;
+		combine_logic logic = allOf;
+		std::vector<first_error_handler *> branches;
+	};
+
+	struct frame {
+		json::value_t type = json::value_t::discarded; // discarded for the document itself
+		instance_path path;
+		std::vector<container_check> checks;
+		std::vector<finalizer> finalizers;
+		std::vector<std::unique_ptr<first_error_handler>> branches;
+		std::vector<check> pending; // checks of the member-value following key
+		std::size_t count = 0;      // members seen so far
+		std::string key;            // of the current member
+		json collected;             // the value, if collecting starts with this frame
+		json *value = nullptr;      // the value, if it is collected
+	};
+
+	const compiled_schema &schema_;
+	std::deque<frame> frames_; // references to frames stay valid while they are open
+	std::string parse_error_;
+	std::vector<std::size_t> matches_; // patternProperties matching a key
+
+	impl(const compiled_schema &schema, basic_error_handler &e)
+	    : schema_(schema)
+	{
+		if (schema.root_ == nullptr)
+			throw std::invalid_argument("no root-schema has been inserted. Cannot validate an instance without it.");
+
+		frames_.emplace_back();
+		frames_.back().pending.push_back({schema.root_, &e});
+	}
+
+	static instance_path member_path(const frame &f)
+	{
+		switch (f.type) {
+		case json::value_t::object:
+			return instance_path(f.path, f.key);
+		case json::value_t::array:
+			return instance_path(f.path, f.count);
+		default:
+			return f.path;
+		}
+	}
+
+	// the checks of the next member-value of f
+	std::vector<check> member_checks(frame &f)
+	{
+		std::vector<check> checks;
+
+		if (f.type != json::value_t::array) {
+			checks.swap(f.pending);
+			return checks;
+		}
+
+		for (auto &c : f.checks) {
+			const auto &array = *c.sch->array;
+
+			if (!array.items_is_tuple) {
+				if (array.items)
+					checks.push_back({array.items, c.e});
+			} else if (f.count < array.items_tuple.size())
+				checks.push_back({array.items_tuple[f.count], c.e});
+			else {
+				switch (array.additional_items) {
+				case schema::array_keywords::Object:
+					checks.push_back({array.additional_items_schema, c.e});
+					break;
+
+				case schema::array_keywords::False:
+					if (!c.additional_items_reported)
+						report(*c.e, instance_path(f.path, f.count), json(), "additional values in array are not allowed");
+					c.additional_items_reported = true;
+					break;
+
+				case schema::array_keywords::True:
+					break;
+				}
+			}
+		}
+		return checks;
+	}
+
+	static json *append(frame &f, json &&value)
+	{
+		if (f.type == json::value_t::array) {
+			f.value->push_back(std::move(value));
+			return &f.value->back();
+		}
+		return &((*f.value)[f.key] = std::move(value));
+	}
+
+	first_error_handler *new_branch(frame &f)
+	{
+		f.branches.emplace_back(new first_error_handler);
+		return f.branches.back().get();
+	}
+
+	// expands a schema to be evaluated on the container of frame f
+	void open(frame &f, const schema *sch, basic_error_handler *e)
+	{
+		sch = schema_.resolve_refs(*sch);
+
+		finalizer fin;
+		fin.e = e;
+
+		// enum and uniqueItems need the whole value
+		if (sch->enum_ || (f.type == json::value_t::array && sch->array && sch->array->unique_items)) {
+			fin.kind = finalizer::collected;
+			fin.sch = sch;
+			f.finalizers.push_back(std::move(fin));
+			return;
+		}
+
+		validate_type(*sch, json(f.type), f.path, *e);
+
+		if (sch->not_) {
+			auto branch = new_branch(f);
+			open(f, sch->not_, branch);
+
+			fin.kind = finalizer::not_;
+			fin.branches = {branch};
+			f.finalizers.push_back(fin);
+		}
+
+		const std::tuple<combine_logic, const std::vector<const schema *> *, const schema::discriminator *> combinations[] = {
+		    std::make_tuple(allOf, &sch->all_of, nullptr),
+		    std::make_tuple(anyOf, &sch->any_of, sch->any_of_discriminator.get()),
+		    std::make_tuple(oneOf, &sch->one_of, sch->one_of_discriminator.get())};
+
+		for (const auto &combination : combinations) {
+			const auto &combined_schemas = *std::get<1>(combination);
+			const auto discriminator = std::get<2>(combination);
+
+			if (combined_schemas.empty())
+				continue;
+
+			// property-values are not known yet, but the type is
+			const std::size_t only = discriminator ? discriminator->branch(f.type) : std::string::npos;
+
+			fin.kind = finalizer::combination;
+			fin.logic = std::get<0>(combination);
+			fin.branches.clear();
+			for (std::size_t i = 0; i < combined_schemas.size(); i++) {
+				if (only != std::string::npos && i != only)
+					continue;
+
+				auto branch = new_branch(f);
+				open(f, combined_schemas[i], branch);
+				fin.branches.push_back(branch);
+			}
+			f.finalizers.push_back(fin);
+		}
+
+		if ((f.type == json::value_t::object && sch->object) ||
+		    (f.type == json::value_t::array && sch->array)) {
+			container_check c;
+			c.sch = sch;
+			c.e = e;
+
+			if (sch->object) {
+				c.present.reset(new presence_set(sch->object->slot_words));
+
+				// whether a dependency applies is only known at the end
+				for (const auto &dep : sch->object->dependencies)
+					if (dep.sub_schema) {
+						auto branch = new_branch(f);
+						open(f, dep.sub_schema, branch);
+						c.dependency_errors.push_back(branch);
+					}
+			}
+			f.checks.push_back(std::move(c));
+
+			fin.kind = finalizer::container;
+			fin.index = f.checks.size() - 1;
+			fin.branches.clear();
+			f.finalizers.push_back(fin);
+		}
+	}
+
+	void value(json &&scalar)
+	{
+		frame &f = frames_.back();
+		const instance_path path = member_path(f);
+
+		for (const auto &c : member_checks(f))
+			schema_.validate(scalar, *c.sch, path, *c.e);
+
+		if (f.value)
+			append(f, std::move(scalar));
+		f.count++;
+	}
+
+	void start(json::value_t type)
+	{
+		frame &parent = frames_.back();
+		const auto checks = member_checks(parent);
+
+		frames_.emplace_back();
+		frame &f = frames_.back();
+		f.type = type;
+		f.path = member_path(parent);
+
+		for (const auto &c : checks)
+			open(f, c.sch, c.e);
+
+		if (parent.value)
+			f.value = append(parent, json(type));
+		else
+			for (const auto &fin : f.finalizers)
+				if (fin.kind == finalizer::collected) {
+					f.collected = json(type);
+					f.value = &f.collected;
+					break;
+				}
+
+		parent.count++;
+	}
+
+	void key(const std::string &key)
+	{
+		frame &f = frames_.back();
+		f.key = key;
+		f.pending.clear();
+
+		for (auto &c : f.checks) {
+			const auto &object = *c.sch->object;
+			bool property_or_patternProperties_matched = false;
+
+			auto prop = std::lower_bound(object.properties.cbegin(), object.properties.cend(), key,
+			                             [](const schema::object_keywords::property &p, const std::string &key) { return p.name < key; });
+
+			if (prop != object.properties.cend() && prop->name == key) {
+				if (prop->slot != std::string::npos)
+					c.present->set(prop->slot);
+
+				if (prop->sub_schema) {
+					f.pending.push_back({prop->sub_schema, c.e});
+					property_or_patternProperties_matched = true;
+				}
+			}
+
+			if (!object.patterns.empty() && object.patterns.match(key, matches_)) {
+				for (auto i : matches_)
+					f.pending.push_back({object.pattern_properties[i], c.e});
+				property_or_patternProperties_matched = true;
+			}
+
+			if (property_or_patternProperties_matched)
+				continue;
+
+			switch (object.additional_properties) {
+			case schema::object_keywords::True:
+				break;
+
+			case schema::object_keywords::Object:
+				f.pending.push_back({object.additional_properties_schema, c.e});
+				break;
+
+			case schema::object_keywords::False:
+				report(*c.e, instance_path(f.path, f.key), json(), "unknown property '" + key + "' in object");
+				break;
+			}
+		}
+	}
+
+	static void end_object(const frame &f, const container_check &c, const json &instance)
+	{
+		const auto &object = *c.sch->object;
+
+		if (f.count > object.max_properties)
+			report(*c.e, f.path, instance, "object has too many properties.");
+
+		if (f.count < object.min_properties)
+			report(*c.e, f.path, instance, "object has too few properties.");
+
+		if (!c.present->contains(object.required_mask))
+			for (const auto &element : object.required)
+				if (!c.present->test(element.slot))
+					report(*c.e, f.path, instance, "required property '" + element.name + "' not found in object");
+
+		auto dep_err = c.dependency_errors.cbegin();
+		for (const auto &dep : object.dependencies) {
+			const first_error_handler *sub_err = dep.sub_schema ? *dep_err++ : nullptr;
+
+			if (!c.present->test(dep.property.slot))
+				continue;
+
+			if (sub_err && *sub_err)
+				c.e->error(sub_err->path, json(), sub_err->message);
+
+			if (!c.present->contains(dep.mask))
+				for (const auto &prop : dep.properties)
+					if (!c.present->test(prop.slot))
+						report(*c.e, f.path, instance, "failed dependency for '" + dep.property.name + "'. Need property '" + prop.name + "'");
+		}
+	}
+
+	static void end_array(const frame &f, const container_check &c, const json &instance)
+	{
+		const auto &array = *c.sch->array;
+
+		if (f.count > array.max_items)
+			report(*c.e, f.path, instance, "array has too many items.");
+
+		if (f.count < array.min_items)
+			report(*c.e, f.path, instance, "array has too few items.");
+	}
+
+	static void combine(const frame &f, const finalizer &fin, const json &instance)
+	{
+		std::size_t count = 0;
+		std::ostringstream sub_schema_err;
+
+		for (const auto branch : fin.branches)
+			if (*branch)
+				sub_schema_err << "  one schema failed because: At " << branch->path << " - " << branch->message << "\n";
+			else
+				count++;
+
+		if (fin.logic == allOf && count < fin.branches.size())
+			report(*fin.e, f.path, instance, "At least one schema has failed where allOf them were requested.\n" + sub_schema_err.str());
+
+		if (fin.logic == oneOf && count > 1)
+			report(*fin.e, f.path, instance, "More than one schema has succeeded where only oneOf them was requested.\n" + sub_schema_err.str());
+
+		if ((fin.logic == anyOf || fin.logic == oneOf) && count == 0)
+			report(*fin.e, f.path, instance, "No schema has succeeded but anyOf/oneOf them should have worked.\n" + sub_schema_err.str());
+	}
+
+	void end()
+	{
+		const frame &f = frames_.back();
+		const json empty(f.type);
+		const json &instance = f.value ? *f.value : empty;
+
+		for (const auto &fin : f.finalizers) {
+			switch (fin.kind) {
+			case finalizer::collected:
+				schema_.validate(instance, *fin.sch, f.path, *fin.e);
+				break;
+
+			case finalizer::container:
+				if (f.type == json::value_t::object)
+					end_object(f, f.checks[fin.index], instance);
+				else
+					end_array(f, f.checks[fin.index], instance);
+				break;
+
+			case finalizer::not_:
+				if (!*fin.branches[0])
+					report(*fin.e, f.path, instance, "schema match but a not-match is defined by schema.");
+				break;
+
+			case finalizer::combination:
+				combine(f, fin, instance);
+				break;
+			}
+		}
+
+		frames_.pop_back();
 	}
+};
+
+sax_validator::sax_validator(const compiled_schema &schema, basic_error_handler &e)
+    : impl_(new impl(schema, e))
+{
+}
+
+sax_validator::~sax_validator() = default;
+
+bool sax_validator::value(json &&scalar)
+{
+	impl_->value(std::move(scalar));
+	return true;
 }
+
+bool sax_validator::start(json::value_t type)
+{
+	impl_->start(type);
+	return true;
+}
+
+bool sax_validator::end()
+{
+	impl_->end();
+	return true;
+}
+
+bool sax_validator::key(json::string_t &val)
+{
+	impl_->key(val);
+	return true;
+}
+
+bool sax_validator::error(const std::string &message)
+{
+	impl_->parse_error_ = message;
+	return false;
+}
+
+const std::string &sax_validator::parse_error_message() const
+{
+	return impl_->parse_error_;
+}
+
 } // namespace json_schema_draft4
 } // namespace nlohmann
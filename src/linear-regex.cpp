@@ -0,0 +1,815 @@
+/*
+ * Modern C++ JSON schema validator
+ *
+ * Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+ *
+ * Copyright (c) 2016 Patrick Boettcher <patrick.boettcher@posteo.de>.
+ *
+ * Permission is hereby  granted, free of charge, to any  person obtaining a
+ * copy of this software and associated  documentation files (the "Software"),
+ * to deal in the Software  without restriction, including without  limitation
+ * the rights to  use, copy,  modify, merge,  publish, distribute,  sublicense,
+ * and/or  sell copies  of  the Software,  and  to  permit persons  to  whom
+ * the Software  is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS
+ * OR IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN
+ * NO EVENT  SHALL THE AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY
+ * CLAIM,  DAMAGES OR  OTHER LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT
+ * OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR
+ * THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "linear-regex.hpp"
+
+#include <algorithm>
+#include <climits>
+
+using nlohmann::json_schema_draft4::linear_regex::automaton;
+using nlohmann::json_schema_draft4::linear_regex::regex_error;
+
+namespace
+{
+
+typedef automaton::char_class char_class;
+typedef automaton::instruction instruction;
+
+const uint32_t no_code_point = 0xFFFFFFFF;
+const uint32_t max_code_point = 0x10FFFF;
+
+// limits protecting against patterns which are themselves hostile
+const unsigned max_repeat = 1000;
+const unsigned max_nesting = 256;
+const std::size_t max_instructions = 100000;
+
+const unsigned infinite = UINT_MAX;
+
+// decodes the UTF-8 sequence at pos, invalid sequences are taken byte by byte
+uint32_t decode(const std::string &s, std::size_t pos, std::size_t &len)
+{
+	const unsigned char c = s[pos];
+	uint32_t cp;
+	std::size_t n;
+
+	len = 1;
+	if (c < 0x80)
+		return c;
+	else if ((c & 0xE0) == 0xC0) {
+		cp = c & 0x1F;
+		n = 2;
+	} else if ((c & 0xF0) == 0xE0) {
+		cp = c & 0x0F;
+		n = 3;
+	} else if ((c & 0xF8) == 0xF0) {
+		cp = c & 0x07;
+		n = 4;
+	} else
+		return c;
+
+	if (pos + n > s.size())
+		return c;
+
+	for (std::size_t i = 1; i < n; i++) {
+		const unsigned char d = s[pos + i];
+		if ((d & 0xC0) != 0x80)
+			return c;
+		cp = (cp << 6) | (d & 0x3F);
+	}
+
+	len = n;
+	return cp;
+}
+
+std::vector<uint32_t> decode(const std::string &s)
+{
+	std::vector<uint32_t> cps;
+	for (std::size_t pos = 0, len; pos < s.size(); pos += len)
+		cps.push_back(decode(s, pos, len));
+	return cps;
+}
+
+bool is_word(uint32_t c)
+{
+	return (c >= 'a' && c <= 'z') ||
+	       (c >= 'A' && c <= 'Z') ||
+	       (c >= '0' && c <= '9') ||
+	       c == '_';
+}
+
+int hex_value(uint32_t c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+void add(char_class &cls, uint32_t lo, uint32_t hi)
+{
+	cls.ranges.push_back(std::make_pair(lo, hi));
+}
+
+// sort and merge the ranges so that contains() can do a binary search
+void normalize(char_class &cls)
+{
+	auto &r = cls.ranges;
+	std::sort(r.begin(), r.end());
+
+	std::size_t n = 0;
+	for (std::size_t i = 0; i < r.size(); i++) {
+		if (n > 0 && r[i].first <= r[n - 1].second + 1)
+			r[n - 1].second = std::max(r[n - 1].second, r[i].second);
+		else
+			r[n++] = r[i];
+	}
+	r.resize(n);
+}
+
+// adds all code-points not in the (unnormalized) set to cls
+void add_complement(char_class &cls, char_class set)
+{
+	normalize(set);
+
+	uint32_t next = 0;
+	for (auto &r : set.ranges) {
+		if (r.first > next)
+			add(cls, next, r.first - 1);
+		next = r.second + 1;
+	}
+	if (next <= max_code_point)
+		add(cls, next, max_code_point);
+}
+
+void add_digits(char_class &cls)
+{
+	add(cls, '0', '9');
+}
+
+void add_word(char_class &cls)
+{
+	add(cls, '0', '9');
+	add(cls, 'A', 'Z');
+	add(cls, '_', '_');
+	add(cls, 'a', 'z');
+}
+
+// WhiteSpace and LineTerminator of ECMA-262
+void add_space(char_class &cls)
+{
+	add(cls, 0x09, 0x0D);
+	add(cls, 0x20, 0x20);
+	add(cls, 0xA0, 0xA0);
+	add(cls, 0x1680, 0x1680);
+	add(cls, 0x2000, 0x200A);
+	add(cls, 0x2028, 0x2029);
+	add(cls, 0x202F, 0x202F);
+	add(cls, 0x205F, 0x205F);
+	add(cls, 0x3000, 0x3000);
+	add(cls, 0xFEFF, 0xFEFF);
+}
+
+struct node {
+	enum kind_t {
+		sequence,
+		alternation,
+		repeat,
+		consume,
+		assertion,
+	};
+
+	kind_t kind;
+	std::size_t value; // class-index for consume, op for assertion
+	unsigned min, max; // for repeat
+	std::vector<node> children;
+
+	explicit node(kind_t kind, std::size_t value = 0)
+	    : kind(kind), value(value), min(0), max(0) {}
+};
+
+class parser
+{
+	const std::string &pattern_;
+	std::vector<uint32_t> p_;
+	std::size_t i_ = 0;
+	unsigned depth_ = 0;
+
+	std::vector<char_class> &classes_;
+
+	bool at_end() const { return i_ == p_.size(); }
+	bool peek(uint32_t c) const { return !at_end() && p_[i_] == c; }
+
+	[[noreturn]] void fail(const std::string &message) const
+	{
+		throw regex_error("invalid pattern '" + pattern_ + "': " + message);
+	}
+
+	node make_class(const char_class &cls)
+	{
+		classes_.push_back(cls);
+		normalize(classes_.back());
+		return node(node::consume, classes_.size() - 1);
+	}
+
+	node literal(uint32_t c)
+	{
+		char_class cls;
+		add(cls, c, c);
+		return make_class(cls);
+	}
+
+	// reads n hex-digits after p_[i_] - if present
+	bool hex(std::size_t n, uint32_t &c)
+	{
+		if (i_ + n > p_.size())
+			return false;
+
+		uint32_t v = 0;
+		for (std::size_t k = 0; k < n; k++) {
+			int h = hex_value(p_[i_ + k]);
+			if (h < 0)
+				return false;
+			v = v * 16 + h;
+		}
+		i_ += n;
+		c = v;
+		return true;
+	}
+
+	// parses an escape-sequence after the backslash, sets are added to cls
+	// and true is returned, otherwise c is the escaped code-point
+	bool escape(char_class &cls, bool in_class, uint32_t &c)
+	{
+		if (at_end())
+			fail("trailing backslash");
+
+		c = p_[i_++];
+		switch (c) {
+		case 'd':
+			add_digits(cls);
+			return true;
+		case 'w':
+			add_word(cls);
+			return true;
+		case 's':
+			add_space(cls);
+			return true;
+		case 'D':
+		case 'W':
+		case 'S': {
+			char_class set;
+			if (c == 'D')
+				add_digits(set);
+			else if (c == 'W')
+				add_word(set);
+			else
+				add_space(set);
+			add_complement(cls, set);
+			return true;
+		}
+
+		case 'b': // only reached in a class, outside it is an assertion
+			c = 0x08;
+			break;
+		case 't':
+			c = 0x09;
+			break;
+		case 'n':
+			c = 0x0A;
+			break;
+		case 'v':
+			c = 0x0B;
+			break;
+		case 'f':
+			c = 0x0C;
+			break;
+		case 'r':
+			c = 0x0D;
+			break;
+
+		case 'c':
+			if (!at_end() && ((p_[i_] >= 'a' && p_[i_] <= 'z') ||
+			                  (p_[i_] >= 'A' && p_[i_] <= 'Z')))
+				c = p_[i_++] % 32;
+			else { // not a control-escape, the backslash is taken literally
+				--i_;
+				c = '\\';
+			}
+			break;
+
+		case 'x':
+			if (!hex(2, c))
+				c = 'x';
+			break;
+
+		case 'u':
+			if (!hex(4, c))
+				c = 'u';
+			else if (c >= 0xD800 && c <= 0xDBFF && i_ + 1 < p_.size() &&
+			         p_[i_] == '\\' && p_[i_ + 1] == 'u') { // surrogate pair
+				std::size_t lead_end = i_;
+				uint32_t trail;
+				i_ += 2;
+				if (hex(4, trail) && trail >= 0xDC00 && trail <= 0xDFFF)
+					c = 0x10000 + ((c - 0xD800) << 10) + (trail - 0xDC00);
+				else
+					i_ = lead_end;
+			}
+			break;
+
+		case '0':
+			if (!at_end() && p_[i_] >= '0' && p_[i_] <= '9')
+				fail("octal escapes are not supported");
+			c = 0;
+			break;
+
+		default:
+			if (c >= '1' && c <= '9')
+				fail(in_class ? "octal escapes are not supported"
+				              : "back-references are not supported");
+			break; // identity-escape
+		}
+
+		return false;
+	}
+
+	node bracket_class()
+	{
+		char_class cls;
+		if (peek('^')) {
+			++i_;
+			cls.negated = true;
+		}
+
+		for (;;) {
+			if (at_end())
+				fail("missing ']'");
+			if (peek(']')) {
+				++i_;
+				break;
+			}
+
+			uint32_t lo;
+			bool set = class_atom(cls, lo);
+
+			if (peek('-') && i_ + 1 < p_.size() && p_[i_ + 1] != ']') {
+				++i_;
+				uint32_t hi;
+				bool set_hi = class_atom(cls, hi);
+
+				if (set || set_hi) { // the '-' is taken literally
+					if (!set)
+						add(cls, lo, lo);
+					if (!set_hi)
+						add(cls, hi, hi);
+					add(cls, '-', '-');
+				} else if (lo > hi)
+					fail("range out of order in character class");
+				else
+					add(cls, lo, hi);
+			} else if (!set)
+				add(cls, lo, lo);
+		}
+
+		return make_class(cls);
+	}
+
+	bool class_atom(char_class &cls, uint32_t &c)
+	{
+		if (peek('\\')) {
+			++i_;
+			return escape(cls, true, c);
+		}
+		c = p_[i_++];
+		return false;
+	}
+
+	// reads a decimal number of up to max_repeat + 1
+	bool number(std::size_t &j, unsigned &n) const
+	{
+		std::size_t start = j;
+		n = 0;
+		while (j < p_.size() && p_[j] >= '0' && p_[j] <= '9') {
+			n = std::min(n * 10 + (p_[j] - '0'), max_repeat + 1);
+			j++;
+		}
+		return j != start;
+	}
+
+	// a braced quantifier - if it is none, '{' is a literal character
+	bool braces(unsigned &min, unsigned &max)
+	{
+		std::size_t j = i_ + 1;
+		if (!number(j, min))
+			return false;
+
+		max = min;
+		if (j < p_.size() && p_[j] == ',') {
+			j++;
+			if (!number(j, max))
+				max = infinite;
+		}
+
+		if (j >= p_.size() || p_[j] != '}')
+			return false;
+
+		i_ = j + 1;
+		return true;
+	}
+
+	bool quantifier(unsigned &min, unsigned &max)
+	{
+		if (at_end())
+			return false;
+
+		switch (p_[i_]) {
+		case '*':
+			min = 0;
+			max = infinite;
+			++i_;
+			break;
+		case '+':
+			min = 1;
+			max = infinite;
+			++i_;
+			break;
+		case '?':
+			min = 0;
+			max = 1;
+			++i_;
+			break;
+		case '{':
+			if (!braces(min, max))
+				return false;
+			break;
+		default:
+			return false;
+		}
+
+		if (peek('?')) // lazy or greedy does not matter for a search
+			++i_;
+
+		if (max != infinite && min > max)
+			fail("numbers out of order in {} quantifier");
+		if (min > max_repeat || (max != infinite && max > max_repeat))
+			fail("repetition count too large");
+
+		return true;
+	}
+
+	node group()
+	{
+		if (peek('?')) {
+			if (i_ + 1 < p_.size() && p_[i_ + 1] == ':')
+				i_ += 2;
+			else
+				fail("look-arounds and named groups are not supported");
+		}
+
+		if (++depth_ > max_nesting)
+			fail("groups nested too deeply");
+
+		node n = disjunction();
+		if (!peek(')'))
+			fail("missing ')'");
+		++i_;
+
+		--depth_;
+		return n;
+	}
+
+	node term()
+	{
+		uint32_t c = p_[i_++];
+		bool quantifiable = true;
+		node n(node::sequence);
+
+		switch (c) {
+		case '^':
+			n = node(node::assertion, instruction::assert_begin);
+			quantifiable = false;
+			break;
+		case '$':
+			n = node(node::assertion, instruction::assert_end);
+			quantifiable = false;
+			break;
+
+		case '\\':
+			if (peek('b') || peek('B')) {
+				n = node(node::assertion, p_[i_++] == 'b' ? instruction::assert_boundary
+				                                          : instruction::assert_no_boundary);
+				quantifiable = false;
+			} else {
+				char_class cls;
+				if (!escape(cls, false, c))
+					add(cls, c, c);
+				n = make_class(cls);
+			}
+			break;
+
+		case '(':
+			n = group();
+			break;
+
+		case '[':
+			n = bracket_class();
+			break;
+
+		case '.': {
+			char_class cls;
+			cls.negated = true;
+			add(cls, '\n', '\n');
+			add(cls, '\r', '\r');
+			add(cls, 0x2028, 0x2029);
+			n = make_class(cls);
+		} break;
+
+		case '*':
+		case '+':
+		case '?':
+			fail("nothing to repeat");
+
+		case '{': {
+			unsigned min, max;
+			--i_;
+			if (braces(min, max))
+				fail("nothing to repeat");
+			++i_;
+			n = literal(c);
+		} break;
+
+		default:
+			n = literal(c);
+			break;
+		}
+
+		unsigned min, max;
+		if (!quantifier(min, max))
+			return n;
+
+		if (!quantifiable)
+			fail("nothing to repeat");
+
+		node r(node::repeat);
+		r.min = min;
+		r.max = max;
+		r.children.push_back(std::move(n));
+		return r;
+	}
+
+	node alternative()
+	{
+		node n(node::sequence);
+		while (!at_end() && !peek('|') && !peek(')'))
+			n.children.push_back(term());
+		return n;
+	}
+
+	node disjunction()
+	{
+		node n(node::alternation);
+		n.children.push_back(alternative());
+		while (peek('|')) {
+			++i_;
+			n.children.push_back(alternative());
+		}
+		return n;
+	}
+
+public:
+	parser(const std::string &pattern, std::vector<char_class> &classes)
+	    : pattern_(pattern), p_(decode(pattern)), classes_(classes) {}
+
+	node parse()
+	{
+		node n = disjunction();
+		if (!at_end())
+			fail("unmatched ')'");
+		return n;
+	}
+};
+
+class compiler
+{
+	std::vector<instruction> &program_;
+	std::size_t begin_;
+
+	std::size_t emit(instruction::op_t op, std::size_t x = 0, std::size_t y = 0)
+	{
+		if (program_.size() - begin_ >= max_instructions)
+			throw regex_error("pattern too large");
+		program_.push_back({op, x, y});
+		return program_.size() - 1;
+	}
+
+public:
+	explicit compiler(std::vector<instruction> &program)
+	    : program_(program), begin_(program.size()) {}
+
+	void compile(const node &n)
+	{
+		switch (n.kind) {
+		case node::sequence:
+			for (auto &child : n.children)
+				compile(child);
+			break;
+
+		case node::consume:
+			emit(instruction::consume, n.value);
+			break;
+
+		case node::assertion:
+			emit(static_cast<instruction::op_t>(n.value));
+			break;
+
+		case node::alternation: {
+			std::vector<std::size_t> jumps;
+			for (std::size_t k = 0; k + 1 < n.children.size(); k++) {
+				std::size_t split = emit(instruction::split, program_.size() + 1);
+				compile(n.children[k]);
+				jumps.push_back(emit(instruction::jump));
+				program_[split].y = program_.size();
+			}
+			compile(n.children.back());
+			for (auto j : jumps)
+				program_[j].x = program_.size();
+		} break;
+
+		case node::repeat:
+			for (unsigned k = 0; k < n.min; k++)
+				compile(n.children[0]);
+
+			if (n.max == infinite) {
+				std::size_t loop = emit(instruction::split, program_.size() + 1);
+				compile(n.children[0]);
+				emit(instruction::jump, loop);
+				program_[loop].y = program_.size();
+			} else {
+				std::vector<std::size_t> splits;
+				for (unsigned k = n.min; k < n.max; k++) {
+					splits.push_back(emit(instruction::split, program_.size() + 1));
+					compile(n.children[0]);
+				}
+				for (auto s : splits)
+					program_[s].y = program_.size();
+			}
+			break;
+		}
+	}
+};
+
+} // anonymous namespace
+
+namespace nlohmann
+{
+namespace json_schema_draft4
+{
+namespace linear_regex
+{
+
+bool automaton::char_class::contains(uint32_t c) const
+{
+	auto it = std::upper_bound(ranges.begin(), ranges.end(), c,
+	                           [](uint32_t v, const std::pair<uint32_t, uint32_t> &r) { return v < r.first; });
+	bool found = it != ranges.begin() && c <= (it - 1)->second;
+	return found != negated;
+}
+
+void automaton::add(const std::string &pattern)
+{
+	const std::size_t instructions = program_.size(), classes = classes_.size();
+
+	try {
+		node ast = parser(pattern, classes_).parse();
+		compiler(program_).compile(ast);
+	} catch (...) { // leave the automaton as it was
+		program_.resize(instructions);
+		classes_.resize(classes);
+		throw;
+	}
+
+	program_.push_back({instruction::match, starts_.size(), 0});
+	starts_.push_back(instructions);
+}
+
+bool automaton::search(const std::string &subject, std::vector<bool> *matched) const
+{
+	if (starts_.empty())
+		return false;
+
+	bool anchored = true;
+	for (auto start : starts_)
+		anchored = anchored && program_[start].op == instruction::assert_begin;
+
+	std::size_t unmatched = starts_.size();
+
+	// threads waiting to consume the current code-point, each instruction is
+	// added at most once per position - marked with the position's generation
+	std::vector<std::size_t> current, next, stack;
+	std::vector<std::size_t> mark(program_.size(), 0);
+	std::size_t generation = 1;
+
+	current.reserve(program_.size());
+	next.reserve(program_.size());
+
+	std::size_t pos = 0, len = 0;
+	uint32_t prev = no_code_point;
+	uint32_t cur = subject.empty() ? no_code_point : decode(subject, 0, len);
+
+	// follows all non-consuming instructions from pc at position at (between
+	// the code-points before and after) and collects the consuming ones into
+	// list, returns true if a match is reached
+	auto add = [&](std::vector<std::size_t> &list, std::size_t pc,
+	               std::size_t at, uint32_t before, uint32_t after) {
+		stack.clear();
+		stack.push_back(pc);
+
+		while (!stack.empty()) {
+			pc = stack.back();
+			stack.pop_back();
+
+			if (mark[pc] == generation)
+				continue;
+			mark[pc] = generation;
+
+			const instruction &in = program_[pc];
+			switch (in.op) {
+			case instruction::match:
+				if (!matched)
+					return true;
+				if (!(*matched)[in.x]) {
+					(*matched)[in.x] = true;
+					if (--unmatched == 0)
+						return true;
+				}
+				break;
+			case instruction::consume:
+				list.push_back(pc);
+				break;
+			case instruction::split:
+				stack.push_back(in.y);
+				stack.push_back(in.x);
+				break;
+			case instruction::jump:
+				stack.push_back(in.x);
+				break;
+			case instruction::assert_begin:
+				if (at == 0)
+					stack.push_back(pc + 1);
+				break;
+			case instruction::assert_end:
+				if (at == subject.size())
+					stack.push_back(pc + 1);
+				break;
+			case instruction::assert_boundary:
+			case instruction::assert_no_boundary:
+				if ((is_word(before) != is_word(after)) == (in.op == instruction::assert_boundary))
+					stack.push_back(pc + 1);
+				break;
+			}
+		}
+		return false;
+	};
+
+	for (;;) {
+		// a new match may start at every position
+		if (!anchored || pos == 0)
+			for (auto start : starts_)
+				if (add(current, start, pos, prev, cur))
+					return true;
+
+		if (pos == subject.size() || (anchored && current.empty()))
+			return matched && unmatched < starts_.size();
+
+		generation++;
+		next.clear();
+
+		std::size_t next_pos = pos + len, next_len = 0;
+		uint32_t next_cur = next_pos < subject.size() ? decode(subject, next_pos, next_len) : no_code_point;
+
+		for (auto pc : current)
+			if (classes_[program_[pc].x].contains(cur))
+				if (add(next, pc + 1, next_pos, cur, next_cur))
+					return true;
+
+		current.swap(next);
+		pos = next_pos;
+		len = next_len;
+		prev = cur;
+		cur = next_cur;
+	}
+}
+
+regex::regex(const std::string &pattern, flag_type)
+{
+	automaton_.add(pattern);
+}
+
+} // linear_regex
+} // json_schema_draft4
+} // nlohmann
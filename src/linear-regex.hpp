@@ -0,0 +1,152 @@
+/*
+ * Modern C++ JSON schema validator
+ *
+ * Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+ *
+ * Copyright (c) 2016 Patrick Boettcher <patrick.boettcher@posteo.de>.
+ *
+ * Permission is hereby  granted, free of charge, to any  person obtaining a
+ * copy of this software and associated  documentation files (the "Software"),
+ * to deal in the Software  without restriction, including without  limitation
+ * the rights to  use, copy,  modify, merge,  publish, distribute,  sublicense,
+ * and/or  sell copies  of  the Software,  and  to  permit persons  to  whom
+ * the Software  is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS
+ * OR IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN
+ * NO EVENT  SHALL THE AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY
+ * CLAIM,  DAMAGES OR  OTHER LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT
+ * OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR
+ * THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef NLOHMANN_JSON_SCHEMA_LINEAR_REGEX_HPP__
+#define NLOHMANN_JSON_SCHEMA_LINEAR_REGEX_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace nlohmann
+{
+namespace json_schema_draft4
+{
+namespace linear_regex
+{
+
+// A regular-expression engine for the ECMAScript-subset used by JSON schema's
+// "pattern" and "patternProperties". The pattern is compiled to a
+// Thompson-automaton which is simulated breadth-first: matching never
+// backtracks, a search costs at most O(length of input * size of pattern).
+//
+// The interface mimics what is used from std::regex so that it can be selected
+// via REGEX_NAMESPACE. Patterns using back-references or look-arounds cannot
+// be matched in linear time and are rejected with a regex_error, as are
+// syntactically invalid patterns. Matching is done on UTF-8 code-points.
+
+class regex_error : public std::runtime_error
+{
+public:
+	explicit regex_error(const std::string &what)
+	    : std::runtime_error(what) {}
+};
+
+// The automaton behind regex and regex_set: any number of patterns compiled
+// into one program, each with its own entry-point and match-instruction.
+class automaton
+{
+public:
+	struct char_class {
+		std::vector<std::pair<uint32_t, uint32_t>> ranges; // sorted, non-overlapping
+		bool negated = false;
+
+		bool contains(uint32_t c) const;
+	};
+
+	struct instruction {
+		enum op_t {
+			match,            // pattern x matched
+			consume,          // consume a code-point of class x
+			split,            // continue at x and y
+			jump,             // continue at x
+			assert_begin,     // ^
+			assert_end,       // $
+			assert_boundary,  // \b
+			assert_no_boundary // \B
+		};
+
+		op_t op;
+		std::size_t x, y;
+	};
+
+	// compiles pattern as the pattern number size()
+	void add(const std::string &pattern);
+
+	std::size_t size() const { return starts_.size(); }
+
+	// all patterns are searched in one pass over the subject. Without matched
+	// the search stops at the first match of any pattern, otherwise
+	// matched[i] is set for each pattern i found in the subject.
+	bool search(const std::string &subject, std::vector<bool> *matched) const;
+
+private:
+	std::vector<instruction> program_;
+	std::vector<char_class> classes_;
+	std::vector<std::size_t> starts_;
+};
+
+class regex
+{
+public:
+	enum flag_type {
+		ECMAScript = 1,
+	};
+
+	regex() = default;
+	explicit regex(const std::string &pattern, flag_type flags = ECMAScript);
+
+	// true if a part of the subject matches the pattern
+	bool search(const std::string &subject) const { return automaton_.search(subject, nullptr); }
+
+private:
+	automaton automaton_;
+};
+
+// several patterns matched at once - the cost of a search grows with the
+// combined size of the patterns, not with their number times the subject
+class regex_set
+{
+public:
+	// throws regex_error like regex does
+	void add(const std::string &pattern) { automaton_.add(pattern); }
+
+	std::size_t size() const { return automaton_.size(); }
+
+	// matched is resized to size(), matched[i] is true if pattern i matches a
+	// part of the subject
+	void search(const std::string &subject, std::vector<bool> &matched) const
+	{
+		matched.assign(size(), false);
+		automaton_.search(subject, &matched);
+	}
+
+private:
+	automaton automaton_;
+};
+
+inline bool regex_search(const std::string &subject, const regex &re)
+{
+	return re.search(subject);
+}
+
+} // linear_regex
+} // json_schema_draft4
+} // nlohmann
+
+#endif /* NLOHMANN_JSON_SCHEMA_LINEAR_REGEX_HPP__ */
@@ -0,0 +1,393 @@
+/*
+ * Modern C++ JSON schema validator
+ *
+ * Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+ *
+ * Copyright (c) 2016 Patrick Boettcher <patrick.boettcher@posteo.de>.
+ *
+ * Permission is hereby  granted, free of charge, to any  person obtaining a
+ * copy of this software and associated  documentation files (the "Software"),
+ * to deal in the Software  without restriction, including without  limitation
+ * the rights to  use, copy,  modify, merge,  publish, distribute,  sublicense,
+ * and/or  sell copies  of  the Software,  and  to  permit persons  to  whom
+ * the Software  is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS
+ * OR IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN
+ * NO EVENT  SHALL THE AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY
+ * CLAIM,  DAMAGES OR  OTHER LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT
+ * OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR
+ * THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "json-schema.hpp"
+
+#include <algorithm>
+
+// Checkers of the formats defined by draft 4, written as single-pass parsers
+// of the grammars of the respective RFCs.
+
+namespace
+{
+
+bool is_digit(char c) { return c >= '0' && c <= '9'; }
+bool is_alpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+bool is_hex(char c) { return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'); }
+
+// n digits at s[i], as a number
+bool digits(const std::string &s, std::size_t &i, std::size_t n, unsigned &value)
+{
+	value = 0;
+	for (std::size_t end = i + n; i < end; i++) {
+		if (i >= s.size() || !is_digit(s[i]))
+			return false;
+		value = value * 10 + (s[i] - '0');
+	}
+	return true;
+}
+
+bool expect(const std::string &s, std::size_t &i, char c)
+{
+	if (i < s.size() && s[i] == c) {
+		i++;
+		return true;
+	}
+	return false;
+}
+
+// RFC 3339, section 5.6: full-date "T" full-time
+bool is_date_time(const std::string &s)
+{
+	std::size_t i = 0;
+	unsigned year, month, day, hour, minute, second;
+
+	if (!digits(s, i, 4, year) || !expect(s, i, '-') ||
+	    !digits(s, i, 2, month) || !expect(s, i, '-') ||
+	    !digits(s, i, 2, day))
+		return false;
+
+	static const unsigned days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+	const bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+	if (month < 1 || month > 12 || day < 1 || day > days[month - 1] + (month == 2 && leap))
+		return false;
+
+	if (!(expect(s, i, 'T') || expect(s, i, 't')))
+		return false;
+
+	if (!digits(s, i, 2, hour) || !expect(s, i, ':') ||
+	    !digits(s, i, 2, minute) || !expect(s, i, ':') ||
+	    !digits(s, i, 2, second))
+		return false;
+
+	if (hour > 23 || minute > 59 || second > 60) // 60 is a leap-second
+		return false;
+
+	if (expect(s, i, '.')) { // time-secfrac
+		const std::size_t start = i;
+		while (i < s.size() && is_digit(s[i]))
+			i++;
+		if (i == start)
+			return false;
+	}
+
+	// time-offset
+	if (expect(s, i, 'Z') || expect(s, i, 'z'))
+		return i == s.size();
+
+	if (!(expect(s, i, '+') || expect(s, i, '-')))
+		return false;
+
+	if (!digits(s, i, 2, hour) || !expect(s, i, ':') || !digits(s, i, 2, minute))
+		return false;
+
+	return hour <= 23 && minute <= 59 && i == s.size();
+}
+
+// RFC 1034, section 3.1, with labels starting with digits as of RFC 1123
+bool is_hostname(const std::string &s, std::size_t begin, std::size_t end)
+{
+	if (end == begin || end - begin > 253)
+		return false;
+
+	std::size_t label = begin; // start of the current label
+	for (std::size_t i = begin; i <= end; i++) {
+		if (i == end || s[i] == '.') {
+			if (i == label || i - label > 63 || s[label] == '-' || s[i - 1] == '-')
+				return false;
+			label = i + 1;
+		} else if (!is_alpha(s[i]) && !is_digit(s[i]) && s[i] != '-')
+			return false;
+	}
+	return true;
+}
+
+// dotted-quad, RFC 2673, section 3.2 - without leading zeros
+bool is_ipv4(const std::string &s, std::size_t begin, std::size_t end)
+{
+	std::size_t i = begin;
+
+	for (int part = 0; part < 4; part++) {
+		if (part > 0 && !(i < end && s[i++] == '.'))
+			return false;
+
+		const std::size_t start = i;
+		unsigned value = 0;
+		while (i < end && is_digit(s[i]) && i - start < 3)
+			value = value * 10 + (s[i++] - '0');
+
+		if (i == start || value > 255 || (s[start] == '0' && i - start > 1))
+			return false;
+	}
+	return i == end;
+}
+
+// RFC 4291, section 2.2: eight groups of up to four hex-digits, a run of
+// zero-groups compressed to "::" and the last two groups as an IPv4-address
+bool is_ipv6(const std::string &s, std::size_t begin, std::size_t end)
+{
+	std::size_t i = begin;
+	int groups = 0;
+	bool compressed = false;
+
+	if (end - begin >= 2 && s[i] == ':' && s[i + 1] == ':') {
+		compressed = true;
+		i += 2;
+	}
+
+	while (i < end) {
+		std::size_t j = i;
+		while (j < end && is_hex(s[j]) && j - i < 4)
+			j++;
+
+		if (j < end && s[j] == '.') { // the IPv4-address, last
+			if (!is_ipv4(s, i, end))
+				return false;
+			groups += 2;
+			break;
+		}
+
+		if (j == i)
+			return false;
+		groups++;
+
+		if (j == end)
+			break;
+
+		if (s[j] != ':')
+			return false;
+		j++;
+
+		if (j < end && s[j] == ':') {
+			if (compressed)
+				return false;
+			compressed = true;
+			j++;
+		} else if (j == end) // a single trailing colon
+			return false;
+
+		i = j;
+	}
+
+	return compressed ? groups <= 7 : groups == 8;
+}
+
+// RFC 5322, section 3.4.1: addr-spec - dot-atom or quoted-string "@" hostname or domain-literal
+bool is_email(const std::string &s)
+{
+	static const std::string atext_specials = "!#$%&'*+-/=?^_`{|}~";
+	std::size_t i = 0;
+
+	if (expect(s, i, '"')) {
+		for (;;) {
+			if (i >= s.size())
+				return false;
+			if (s[i] == '"')
+				break;
+			if (s[i] == '\\')
+				i++;
+			i++;
+		}
+		i++;
+	} else {
+		const std::size_t start = i;
+		for (; i < s.size() && s[i] != '@'; i++) {
+			if (s[i] == '.') {
+				if (i == start || s[i - 1] == '.')
+					return false;
+			} else if (!is_alpha(s[i]) && !is_digit(s[i]) && atext_specials.find(s[i]) == std::string::npos &&
+			           static_cast<unsigned char>(s[i]) < 0x80) // allow UTF-8, RFC 6531
+				return false;
+		}
+		if (i == start || s[i - 1] == '.')
+			return false;
+	}
+
+	if (!expect(s, i, '@'))
+		return false;
+
+	if (i < s.size() && s[i] == '[' && s[s.size() - 1] == ']') {
+		const std::string ipv6_tag = "IPv6:";
+		if (s.compare(i + 1, ipv6_tag.size(), ipv6_tag) == 0)
+			return is_ipv6(s, i + 1 + ipv6_tag.size(), s.size() - 1);
+		return is_ipv4(s, i + 1, s.size() - 1);
+	}
+
+	return is_hostname(s, i, s.size());
+}
+
+// RFC 3986, section 2: the characters a part of an URI may consist of
+bool uri_chars(const std::string &s, std::size_t begin, std::size_t end, const char *extra)
+{
+	static const std::string unreserved_and_sub_delims = "-._~!$&'()*+,;=";
+
+	for (std::size_t i = begin; i < end; i++) {
+		if (s[i] == '%') {
+			if (i + 2 >= end || !is_hex(s[i + 1]) || !is_hex(s[i + 2]))
+				return false;
+			i += 2;
+		} else if (!is_alpha(s[i]) && !is_digit(s[i]) &&
+		           unreserved_and_sub_delims.find(s[i]) == std::string::npos &&
+		           std::string(extra).find(s[i]) == std::string::npos)
+			return false;
+	}
+	return true;
+}
+
+// RFC 3986, section 3: scheme ":" hier-part [ "?" query ] [ "#" fragment ]
+bool is_uri(const std::string &s)
+{
+	// scheme
+	if (s.empty() || !is_alpha(s[0]))
+		return false;
+
+	std::size_t i = 1;
+	while (i < s.size() && (is_alpha(s[i]) || is_digit(s[i]) || s[i] == '+' || s[i] == '-' || s[i] == '.'))
+		i++;
+
+	if (!expect(s, i, ':'))
+		return false;
+
+	const std::size_t fragment = std::min(s.find('#', i), s.size());
+	const std::size_t query = std::min(s.find('?', i), fragment);
+
+	if (fragment < s.size() && !uri_chars(s, fragment + 1, s.size(), ":@/?"))
+		return false;
+
+	if (query < fragment && !uri_chars(s, query + 1, fragment, ":@/?"))
+		return false;
+
+	// authority: [ userinfo "@" ] host [ ":" port ]
+	if (s.compare(i, 2, "//") == 0) {
+		i += 2;
+		const std::size_t authority_end = std::min(s.find('/', i), query);
+
+		const std::size_t at = s.rfind('@', authority_end - 1);
+		if (at != std::string::npos && at >= i) {
+			if (!uri_chars(s, i, at, ":"))
+				return false;
+			i = at + 1;
+		}
+
+		std::size_t host_end;
+		if (i < authority_end && s[i] == '[') { // IP-literal
+			host_end = s.find(']', i);
+			if (host_end == std::string::npos || host_end > authority_end || !is_ipv6(s, i + 1, host_end))
+				return false;
+			host_end++;
+		} else {
+			host_end = std::min(s.find(':', i), authority_end);
+			if (!uri_chars(s, i, host_end, ""))
+				return false;
+		}
+
+		if (host_end < authority_end) { // port
+			if (s[host_end] != ':')
+				return false;
+			for (std::size_t p = host_end + 1; p < authority_end; p++)
+				if (!is_digit(s[p]))
+					return false;
+		}
+		i = authority_end;
+	}
+
+	// path
+	return uri_chars(s, i, query, ":@/");
+}
+
+void check_date_time(const std::string &value)
+{
+	if (!is_date_time(value))
+		throw std::invalid_argument(value + " is not a date-time according to RFC 3339.");
+}
+
+void check_email(const std::string &value)
+{
+	if (!is_email(value))
+		throw std::invalid_argument(value + " is not an email-address according to RFC 5322.");
+}
+
+void check_hostname(const std::string &value)
+{
+	if (!is_hostname(value, 0, value.size()))
+		throw std::invalid_argument(value + " is not a valid hostname.");
+}
+
+void check_ipv4(const std::string &value)
+{
+	if (!is_ipv4(value, 0, value.size()))
+		throw std::invalid_argument(value + " is not an IPv4-address.");
+}
+
+void check_ipv6(const std::string &value)
+{
+	if (!is_ipv6(value, 0, value.size()))
+		throw std::invalid_argument(value + " is not an IPv6-address.");
+}
+
+void check_uri(const std::string &value)
+{
+	if (!is_uri(value))
+		throw std::invalid_argument(value + " is not an URI according to RFC 3986.");
+}
+
+} // anonymous namespace
+
+namespace nlohmann
+{
+namespace json_schema_draft4
+{
+
+void default_string_format_check(const std::string &format, const std::string &value)
+{
+	if (format == "date-time")
+		check_date_time(value);
+	else if (format == "email")
+		check_email(value);
+	else if (format == "hostname")
+		check_hostname(value);
+	else if (format == "ipv4")
+		check_ipv4(value);
+	else if (format == "ipv6")
+		check_ipv6(value);
+	else if (format == "uri")
+		check_uri(value);
+	// other formats are not validated
+}
+
+format_registry default_format_registry()
+{
+	format_registry formats;
+	formats.add("date-time", check_date_time);
+	formats.add("email", check_email);
+	formats.add("hostname", check_hostname);
+	formats.add("ipv4", check_ipv4);
+	formats.add("ipv6", check_ipv6);
+	formats.add("uri", check_uri);
+	return formats;
+}
+
+} // namespace json_schema_draft4
+} // namespace nlohmann
@@ -28,35 +28,24 @@
 #include <fstream>
 #include <regex>
 #include <iostream>
+#include <sstream>
 
 using nlohmann::json;
 using nlohmann::json_uri;
 using nlohmann::json_schema_draft4::json_validator;
 
-static void format_check(const std::string &format, const std::string &value)
+static nlohmann::json_schema_draft4::format_registry formats()
 {
-	if (format == "hostname") {
-		// from http://stackoverflow.com/questions/106179/regular-expression-to-match-dns-hostname-or-ip-address
-		std::regex re(R"(^([a-zA-Z0-9]|[a-zA-Z0-9][a-zA-Z0-9\-]{0,61}[a-zA-Z0-9])(\.([a-zA-Z0-9]|[a-zA-Z0-9][a-zA-Z0-9\-]{0,61}[a-zA-Z0-9]))*$)");
-		if (!std::regex_match(value, re))
-			throw std::invalid_argument(value + " is not a valid hostname.");
-	} else if (format == "ipv4") {
-		std::regex re(R"(^(([0-9]|[1-9][0-9]|1[0-9]{2}|2[0-4][0-9]|25[0-5])\.){3}([0-9]|[1-9][0-9]|1[0-9]{2}|2[0-4][0-9]|25[0-5])$)");
-		if (!std::regex_match(value, re))
-			throw std::invalid_argument(value + " is not a IPv4-address.");
-
-	} else if (format == "ipv6") {
-		std::regex re(R"((([0-9a-fA-F]{1,4}:){7,7}[0-9a-fA-F]{1,4}|([0-9a-fA-F]{1,4}:){1,7}:|([0-9a-fA-F]{1,4}:){1,6}:[0-9a-fA-F]{1,4}|([0-9a-fA-F]{1,4}:){1,5}(:[0-9a-fA-F]{1,4}){1,2}|([0-9a-fA-F]{1,4}:){1,4}(:[0-9a-fA-F]{1,4}){1,3}|([0-9a-fA-F]{1,4}:){1,3}(:[0-9a-fA-F]{1,4}){1,4}|([0-9a-fA-F]{1,4}:){1,2}(:[0-9a-fA-F]{1,4}){1,5}|[0-9a-fA-F]{1,4}:((:[0-9a-fA-F]{1,4}){1,6})|:((:[0-9a-fA-F]{1,4}){1,7}|:)|fe80:(:[0-9a-fA-F]{0,4}){0,4}%[0-9a-zA-Z]{1,}|::(ffff(:0{1,4}){0,1}:){0,1}((25[0-5]|(2[0-4]|1{0,1}[0-9]){0,1}[0-9])\.){3,3}(25[0-5]|(2[0-4]|1{0,1}[0-9]){0,1}[0-9])|([0-9a-fA-F]{1,4}:){1,4}:((25[0-5]|(2[0-4]|1{0,1}[0-9]){0,1}[0-9])\.){3,3}(25[0-5]|(2[0-4]|1{0,1}[0-9]){0,1}[0-9])))");
-		if (!std::regex_match(value, re))
-			throw std::invalid_argument(value + " is not a IPv6-address.");
-	} else if (format == "regex") {
+	auto formats = nlohmann::json_schema_draft4::default_format_registry();
+
+	formats.add("regex", [](const std::string &value) {
 		try {
 			std::regex re(value, std::regex::ECMAScript);
 		} catch (std::exception &e) {
 			throw e;
 		}
-	} else
-		throw std::logic_error("don't know how to validate " + format);
+	});
+	return formats;
 }
 
 static void loader(const json_uri &uri, json &schema)
@@ -104,7 +93,7 @@ int main(void)
 
 		const auto &schema = test_group["schema"];
 
-		json_validator validator(loader, format_check);
+		json_validator validator(loader, formats());
 
 		validator.set_root_schema(schema);
 
@@ -128,6 +117,31 @@ int main(void)
 				std::cout << "    Not yet implemented: " << e.what() << "\n";
 			}
 
+			// the exception-free validation has to come to the same result
+			nlohmann::json_schema_draft4::basic_error_handler err;
+			try {
+				validator.validate(test_case["data"], err);
+				if (!err != valid) {
+					std::cout << "    Error-handler validation returned " << !err << " instead of " << valid << "\n";
+					valid = !test_case["valid"]; /* force test-case failure */
+				}
+			} catch (const std::logic_error &e) {
+				/* not yet implemented, already handled above */
+			}
+
+			// as has the validation while parsing
+			nlohmann::json_schema_draft4::basic_error_handler stream_err;
+			try {
+				std::istringstream stream(test_case["data"].dump());
+				validator.validate_stream(stream, stream_err);
+				if (bool(stream_err) != bool(err)) {
+					std::cout << "    Streaming validation returned " << !stream_err << " instead of " << !err << "\n";
+					valid = !test_case["valid"]; /* force test-case failure */
+				}
+			} catch (const std::logic_error &e) {
+				/* not yet implemented, already handled above */
+			}
+
 			if (valid == test_case["valid"])
 				std::cout << "      --> Test Case exited with " << valid << " as expected.\n";
 			else {
@@ -137,6 +151,28 @@ int main(void)
 			group_total++;
 			std::cout << "\n";
 		}
+
+		// validating all cases of a group in parallel has to come to the same results
+		std::vector<json> instances;
+		for (auto &test_case : test_group["tests"])
+			instances.push_back(test_case["data"]);
+
+		try {
+			auto results = validator.validate_batch(instances, 4);
+
+			for (size_t i = 0; i < results.size(); i++) {
+				nlohmann::json_schema_draft4::basic_error_handler err;
+				validator.validate(instances[i], err);
+
+				if (results[i].valid == err) {
+					std::cout << "  Batch-validation of case " << i << " returned " << results[i].valid << " NOT expected.\n";
+					group_failed++;
+				}
+			}
+		} catch (const std::logic_error &e) {
+			/* not yet implemented, already handled above */
+		}
+
 		total_failed += group_failed;
 		total += group_total;
 		std::cout << "Group RESULT: " << test_group["description"] << " "